@@ -0,0 +1,269 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Game.h"
+#include "Stats.h"
+
+//! Computer only games played as fast as possible without a terminal
+//
+//  Games are shared out between threads, each with its own board, players
+//  and search. Every player makes its first few moves at random, seeded
+//  from the batch seed and the game number, so each game is the same
+//  whichever thread plays it and a batch can be repeated exactly, unless
+//  computer moves are limited by time with movetime or clock.
+//
+//  With the stats option the work done for every turn and game is printed
+//  as it happens, one JSON object per line. Each game's search runs on the
+//  thread playing it, so these are the counts for that thread alone.
+template <unsigned SIZE>
+class Batch
+{
+public:
+   //! Random moves made by each player at the start of a game
+   static const unsigned RANDOM_MOVES = 2;
+
+   Batch(const GameOptions& options_)
+      : options(options_)
+   {}
+
+   //! Play a number of games on a number of threads and print statistics
+   //  Returns false, without playing, if the weights file can't be loaded
+   bool run(unsigned games, unsigned num_threads)
+   {
+      // Shared by every thread, so loaded before any of them start
+      if(!loadWeights<SIZE>(options)) return false;
+
+      std::vector<Result> results(games);
+      std::atomic<unsigned> next_game{0};
+
+      auto start = std::chrono::steady_clock::now();
+
+      std::vector<std::thread> threads;
+
+      for(unsigned i = 0; i < std::max(num_threads, 1u); i++)
+      {
+         threads.emplace_back([this, &results, &next_game, games]()
+                              {
+                                 std::unique_ptr<Table> table(new Table(options));
+
+                                 for(unsigned game; (game = next_game++) < games; )
+                                 {
+                                    results[game] = table->play(game);
+                                 }
+                              });
+      }
+
+      for(auto& thread : threads)
+      {
+         thread.join();
+      }
+
+      auto   end  = std::chrono::steady_clock::now();
+      double secs = std::chrono::duration<double>(end - start).count();
+
+      report(results, secs);
+
+      if(options.stats) Stats::total().printJson("\"type\": \"batch\"");
+
+      return true;
+   }
+
+private:
+   //! Outcome of one game
+   struct Result
+   {
+      unsigned winner{0};   //!< Seat of the winner 1..num_players, or 0 for none
+      unsigned turns{0};
+   };
+
+   //! Everything needed to play games on one thread
+   class Table
+   {
+   public:
+      Table(const GameOptions& options_)
+         : options(options_)
+         , search(trans_table)
+      {
+         move_gen.setAudit(options.audit);
+         trans_table.resize(options.hash);
+
+         // Without a terminal there are no frames, so --speed sets no limit
+         time_manager.setClock(options.clock * 1000);
+         time_manager.setMoveTime(options.movetime);
+      }
+
+      Result play(unsigned game)
+      {
+         unsigned num_players = options.num_players;
+         uint64_t seed        = (uint64_t(options.seed) << 32) + game;
+         unsigned order[6];
+
+         state.clear();
+         trans_table.clear();
+         time_manager.reset();
+
+         for(unsigned i = 0; i < num_players; i++)
+         {
+            Player<SIZE>& player = players[i];
+
+            player.initialise(state, move_gen, trans_table, 1 + i * (6.0 / num_players), /* human */ false);
+            player.setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+            player.setRandomMoves(RANDOM_MOVES, seed * 8 + i);
+
+            if((options.depth != 0) || (options.nodes != 0) ||
+               (options.movetime != 0) || (options.clock != 0))
+            {
+               typename Search<SIZE>::Limits limits;
+
+               limits.depth = options.depth;
+               limits.nodes = options.nodes;
+
+               player.setSearch(&search, limits);
+            }
+
+            if(options.mcts != 0) player.setMcts(&mcts, options.mcts);
+            if(time_manager.isLimited()) player.setTimeManager(&time_manager);
+
+            order[i] = player.getId();
+         }
+
+         search.setPlayers(order, num_players);
+         search.setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+         search.setMode(options.multi <= SEARCH_MAXN ? SearchMode(unsigned(options.multi)) : SEARCH_PARANOID);
+
+         mcts.setPlayers(order, num_players);
+         mcts.setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+         mcts.setSeed(seed);
+
+         Result     result;
+         StatCounts game_start   = Stats::thread();
+         uint64_t   max_think_ns = 0;
+         char       head[128];
+
+         while(result.turns < MAX_TURNS * num_players)
+         {
+            Player<SIZE>& player = players[result.turns % num_players];
+
+            state.setSideToMove(player.getId());
+
+            StatCounts turn_start = Stats::thread();
+
+            for(bool start_turn = true; !player.takeATurn(start_turn, 0); start_turn = false);
+
+            result.turns++;
+
+            if(options.stats)
+            {
+               StatCounts turn = Stats::thread() - turn_start;
+
+               max_think_ns = std::max(max_think_ns, turn[STAT_THINK_NS]);
+
+               snprintf(head, sizeof(head), "\"type\": \"turn\", \"game\": %u, \"turn\": %u, \"seat\": %u",
+                        game, result.turns, 1 + (result.turns - 1) % num_players);
+               turn.printJson(head);
+            }
+
+            if(player.areAllPegsHome())
+            {
+               result.winner = 1 + (result.turns - 1) % num_players;
+               break;
+            }
+         }
+
+         if(options.stats)
+         {
+            snprintf(head, sizeof(head),
+                     "\"type\": \"game\", \"game\": %u, \"turns\": %u, \"winner\": %u, \"max_think_ns\": %llu",
+                     game, result.turns, result.winner, (unsigned long long)max_think_ns);
+            (Stats::thread() - game_start).printJson(head);
+         }
+
+         return result;
+      }
+
+   private:
+      //! Turns for each player before a game is abandoned
+      static const unsigned MAX_TURNS = 50 * SIZE;
+
+      const GameOptions& options;
+      BoardState<SIZE>   state;
+      MoveGen<SIZE>      move_gen;
+      TransTable         trans_table;
+      Search<SIZE>       search;
+      Mcts<SIZE>         mcts;
+      TimeManager        time_manager;
+      Player<SIZE>       players[6];
+   };
+
+   void report(std::vector<Result>& results, double secs) const
+   {
+      unsigned games       = results.size();
+      unsigned wins[7]     = {};
+      uint64_t total_turns = 0;
+
+      for(const auto& result : results)
+      {
+         wins[result.winner]++;
+         total_turns += result.turns;
+      }
+
+      printf("size %u, %u players, %u games in %.2f s, %.2f games/s\n",
+             SIZE, unsigned(options.num_players), games, secs, games / secs);
+
+      if(games == 0) return;
+
+      printf("\nseat   wins   rate\n");
+
+      for(unsigned seat = 1; seat <= options.num_players; seat++)
+      {
+         printf("%4u %6u %5.1f%%\n", seat, wins[seat], 100.0 * wins[seat] / games);
+      }
+
+      printf("none %6u %5.1f%%\n", wins[0], 100.0 * wins[0] / games);
+
+      std::sort(results.begin(), results.end(),
+                [](const Result& a, const Result& b) { return a.turns < b.turns; });
+
+      auto percentile = [&](unsigned p) { return results[(games - 1) * p / 100].turns; };
+
+      printf("\nturns   min   p10   p25   p50   p75   p90   max    mean\n");
+      printf("      %5u %5u %5u %5u %5u %5u %5u %7.1f\n",
+             results.front().turns, percentile(10), percentile(25), percentile(50),
+             percentile(75), percentile(90), results.back().turns,
+             double(total_turns) / games);
+   }
+
+   const GameOptions& options;
+};
+
+#endif
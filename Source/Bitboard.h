@@ -0,0 +1,207 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <array>
+#include <cstdint>
+
+#include "Pos60.h"
+
+//! A set of holes on a size N board, one bit per hole
+//
+//  Bits are laid out on an axial grid (q, r) where r is the Pos60 y
+//  coordinate and q = (x - y) / 2. Each row has one spare guard column so
+//  that a step in any of the six directions is a constant bit offset and
+//  anything that wraps from the end of one row to the start of the next
+//  lands on a guard bit that is never a valid hole.
+template <unsigned N>
+class Bitboard
+{
+public:
+   static const unsigned ROW   = 4 * N + 1;
+   static const unsigned WIDTH = ROW + 1;
+   static const unsigned SIZE  = WIDTH * ROW;
+
+   //! Bit index for a position, false if the position is off the grid
+   static bool getBit(const Pos60& pos, unsigned& bit)
+   {
+      signed   x_y = pos.getX() - pos.getY();
+      unsigned q   = x_y / 2 + 2 * N;
+      unsigned r   = pos.getY() + 2 * N;
+
+      bit = r * WIDTH + q;
+
+      return ((x_y & 1) == 0) && (q < ROW) && (r < ROW);
+   }
+
+   //! Position of a bit index
+   static Pos60 getPos(unsigned bit)
+   {
+      signed q = signed(bit % WIDTH) - 2 * N;
+      signed r = signed(bit / WIDTH) - 2 * N;
+
+      return Pos60(q * 2 + r, r);
+   }
+
+   //! Bit offset of one step in direction dir
+   static signed offset(Dir60 dir)
+   {
+      switch(dir)
+      {
+      case  30: return WIDTH;
+      case  90: return 1;
+      case 150: return 1 - signed(WIDTH);
+      case 210: return -signed(WIDTH);
+      case 270: return -1;
+      case 330: return WIDTH - 1;
+      }
+      return 0;
+   }
+
+   bool test(unsigned bit) const
+   {
+      return (bit < SIZE) && ((word[bit / 64] >> (bit % 64)) & 1);
+   }
+
+   void set(unsigned bit)   { word[bit / 64] |=   uint64_t(1) << (bit % 64); }
+   void reset(unsigned bit) { word[bit / 64] &= ~(uint64_t(1) << (bit % 64)); }
+
+   void clear() { word.fill(0); }
+
+   bool none() const
+   {
+      for(const auto& w : word)
+      {
+         if(w != 0) return false;
+      }
+      return true;
+   }
+
+   bool any() const { return !none(); }
+
+   unsigned count() const
+   {
+      unsigned n = 0;
+      for(const auto& w : word)
+      {
+         n += __builtin_popcountll(w);
+      }
+      return n;
+   }
+
+   Bitboard& operator&=(const Bitboard& that)
+   {
+      for(unsigned i = 0; i < WORDS; i++) word[i] &= that.word[i];
+      return *this;
+   }
+
+   Bitboard& operator|=(const Bitboard& that)
+   {
+      for(unsigned i = 0; i < WORDS; i++) word[i] |= that.word[i];
+      return *this;
+   }
+
+   Bitboard& operator^=(const Bitboard& that)
+   {
+      for(unsigned i = 0; i < WORDS; i++) word[i] ^= that.word[i];
+      return *this;
+   }
+
+   Bitboard operator&(const Bitboard& that) const { return Bitboard(*this) &= that; }
+   Bitboard operator|(const Bitboard& that) const { return Bitboard(*this) |= that; }
+   Bitboard operator^(const Bitboard& that) const { return Bitboard(*this) ^= that; }
+
+   //! Set complement, restricted to the grid
+   Bitboard operator~() const
+   {
+      Bitboard result;
+      for(unsigned i = 0; i < WORDS; i++) result.word[i] = ~word[i];
+      result.trim();
+      return result;
+   }
+
+   bool operator==(const Bitboard& that) const { return word == that.word; }
+   bool operator!=(const Bitboard& that) const { return word != that.word; }
+
+   //! Move every member of the set one step in direction dir
+   //  Members that leave the grid are lost, members that land on guard
+   //  or padding bits must be removed by masking with the valid holes
+   Bitboard shift(Dir60 dir) const
+   {
+      signed n = offset(dir);
+      return n > 0 ? shiftUp(n) : shiftDown(-n);
+   }
+
+   //! Call fn(bit) for each member of the set in ascending bit order
+   template <typename FN>
+   void forEach(FN fn) const
+   {
+      for(unsigned i = 0; i < WORDS; i++)
+      {
+         for(uint64_t w = word[i]; w != 0; w &= w - 1)
+         {
+            fn(i * 64 + __builtin_ctzll(w));
+         }
+      }
+   }
+
+private:
+   static const unsigned WORDS = (SIZE + 63) / 64;
+
+   Bitboard shiftUp(unsigned n) const
+   {
+      Bitboard result;
+      result.word[0] = word[0] << n;
+      for(unsigned i = 1; i < WORDS; i++)
+      {
+         result.word[i] = (word[i] << n) | (word[i - 1] >> (64 - n));
+      }
+      result.trim();
+      return result;
+   }
+
+   Bitboard shiftDown(unsigned n) const
+   {
+      Bitboard result;
+      for(unsigned i = 0; i < WORDS - 1; i++)
+      {
+         result.word[i] = (word[i] >> n) | (word[i + 1] << (64 - n));
+      }
+      result.word[WORDS - 1] = word[WORDS - 1] >> n;
+      return result;
+   }
+
+   //! Clear bits beyond the end of the grid
+   void trim()
+   {
+      if((SIZE % 64) != 0)
+      {
+         word[WORDS - 1] &= (uint64_t(1) << (SIZE % 64)) - 1;
+      }
+   }
+
+   std::array<uint64_t, WORDS> word{};
+};
+
+#endif
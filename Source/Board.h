@@ -23,221 +23,165 @@
 #ifndef BOARD_H
 #define BOARD_H
 
-#include <array>
-#include <cassert>
-#include <cstdio>
-#include <vector>
-
 #include "TRM/Curses.h"
 
-#include "Pos60.h"
-
-
-enum Action : char
-{
-   ACT_NONE,
-   ACT_PICK,
-   ACT_HOP,
-   ACT_DROP
-};
+#include "BoardState.h"
+#include "Trace.h"
 
 
-template <unsigned N>
-class Board
+//! Curses presentation of a board
+//
+//  Changes to the board are collected and only drawn by refresh(), which
+//  redraws the holes and action markers that differ from what is already on
+//  the screen, so any number of changes between calls cost a single frame.
+//
+//  Anything with the cols, lines, fgcolour() and mvaddch() members of
+//  TRM::Curses can be drawn on instead, such as a null window to measure
+//  the cost of drawing.
+template <unsigned N, typename WINDOW = TRM::Curses>
+class Board : public BoardObserver
 {
 public:
-   Board(TRM::Curses& win_)
+   Board(WINDOW& win_, BoardState<N>& state_)
       : win(win_)
+      , state(state_)
    {
       offset_x = (win.cols - X_SIZE) / 2;
       offset_y = 1 + (win.lines - Y_SIZE) / 2;
 
-      clear();
-   }
+      for(Hole hole = 0; hole < HoleTable<N>::NUM_HOLES; hole++)
+      {
+         shown[hole]        = UNKNOWN;
+         action[hole]       = ACT_NONE;
+         shown_action[hole] = ACT_NONE;
+      }
 
-   bool isEmpty(const Pos60& pos) const
-   {
-      uint8_t c = getCell(pos);
-      return (c != INVALID) && !isOccupied(pos);
+      state.setObserver(this);
+      boardChanged();
    }
 
-   bool isOccupied(const Pos60& pos) const
+   ~Board()
    {
-      uint8_t peg = getCell(pos) & 0x0F;
-      return peg != 0;
+      state.setObserver(nullptr);
    }
 
-   bool isPegHome(const Pos60& peg_pos) const
+   void holeChanged(Hole hole) override
    {
-      uint8_t player = getCell(peg_pos) & 0x0F;
-      return (getCell(peg_pos) >> 4) == player;
+      dirty.set(HoleTable<N>::getBit(hole));
    }
 
-   void setEmpty(const Pos60& pos)
+   void boardChanged() override
    {
-      assert(isOccupied(pos));
-      setCell(pos, 0xF0, 0);
+      for(Hole hole = 0; hole < HoleTable<N>::NUM_HOLES; hole++)
+      {
+         holeChanged(hole);
+      }
    }
 
-   void setHome(const Pos60& pos, unsigned player)
+   void showAction(Hole hole, Action action_) override
    {
-      setCell(pos, 0x0F, uint8_t(player << 4));
+      action[hole] = action_;
+      dirty.set(HoleTable<N>::getBit(hole));
    }
 
-   void setPeg(const Pos60& pos, unsigned player)
+   //! Draw everything that has changed since the last refresh
+   void refresh()
    {
-      assert(isEmpty(pos));
-      setCell(pos, 0xF0, uint8_t(player));
-   }
+      Trace::Span span("Board::refresh");
 
-   void showAction(const Pos60& pos, Action action)
-   {
-      unsigned x, y;
-      if(!getXY(pos, x, y)) return;
+      // Markers either side of neighbouring holes share a character so
+      // remove old markers before drawing any new ones
+      dirty.forEach([this](unsigned bit)
+                    {
+                       Hole hole = HoleTable<N>::getHole(bit);
 
-      char lch{}, rch{};
+                       drawHole(hole);
+                       if(action[hole] == ACT_NONE) drawAction(hole);
+                    });
 
-      x += offset_x;
-      y += offset_y;
+      dirty.forEach([this](unsigned bit)
+                    {
+                       Hole hole = HoleTable<N>::getHole(bit);
 
-      switch(action)
-      {
-      case ACT_NONE: lch = ' '; rch = ' '; break;
-      case ACT_PICK: lch = '<'; rch = '>'; break;
-      case ACT_HOP:  lch = '['; rch = ']'; break;
-      case ACT_DROP: lch = '>'; rch = '<'; break;
-      }
+                       if(action[hole] != ACT_NONE) drawAction(hole);
+                    });
 
-      win.fgcolour(7);
-      win.mvaddch(y, x - 1, lch);
-      win.mvaddch(y, x + 1, rch);
+      dirty.clear();
    }
 
-   void clear()
+private:
+   static bool getXY(const Pos60& pos, unsigned& x, unsigned& y)
    {
-      for(unsigned y = 0; y < Y_SIZE; y++)
-      {
-         for(unsigned x = 0; x < X_SIZE; x++)
-         {
-            cell[x][y] = INVALID;
-         }
-
-         // 'n' the number of empty cells in this row
-         unsigned n;
-
-              if (y <  N)        n =      y + 1;
-         else if (y < (N*2 + 1)) n = Y_SIZE - y;
-         else if (y < (N*3 + 1)) n =      y + 1;
-         else                    n = Y_SIZE - y;
-
-         unsigned middle_x = N * 3;
-         unsigned x        = middle_x + 1 - n;
-
-         for(unsigned i = 0; i < n; i++)
-         {
-            cell[x][y] = EMPTY;
-            x += 2;
-         }
-      }
-
-      for(unsigned player = 1; player <= 6; player++)
-      {
-         Dir60 dir(player + 2);
-         Pos60 row(dir, N);
+      x = OFFSET_X + pos.getX();
+      y = OFFSET_Y - pos.getY();
 
-         dir.rotLeft();
-         row.move(dir);
+      return (x < X_SIZE) && (y < Y_SIZE);
+   }
 
-         Dir60 across = dir;
-         across.rotLeft();
+   void setColour(uint8_t colour_)
+   {
+      if(colour_ != colour)
+      {
+         colour = colour_;
+         win.fgcolour(colour);
+      }
+   }
 
-         for(unsigned j = N; j >= 1; j--)
-         {
-            Pos60 pos = row;
+   //! Draw a hole if it is not already shown correctly
+   void drawHole(Hole hole)
+   {
+      uint8_t peg  = state.getPeg(hole);
+      uint8_t home = state.getHome(hole);
+      uint8_t look = (home << 4) | peg;
 
-            for(unsigned k = 0; k < j; k++)
-            {
-               setHome(pos, player);
+      if(look == shown[hole]) return;
 
-               pos.move(across);
-            }
+      shown[hole] = look;
 
-            row.move(dir);
-         }
-      }
-   }
+      unsigned x, y;
+      getXY(HoleTable<N>::getPos(hole), x, y);
 
-   void setWait(bool wait) const
-   {
-      static int prev_timeout{0};
-      if(wait)
+      if(peg != 0)
       {
-         prev_timeout = win.timeout(0);
+         setColour(peg);
+         win.mvaddch(y + offset_y, x + offset_x, 'o');
       }
       else
       {
-         win.timeout(prev_timeout);
+         setColour(home);
+         win.mvaddch(y + offset_y, x + offset_x, '.');
       }
    }
 
-   void refresh() const
+   //! Draw the action marker either side of a hole if it has changed
+   void drawAction(Hole hole)
    {
-      for(unsigned y = 0; y < Y_SIZE; y++)
-      {
-         win.move(y + offset_y, offset_x);
-
-         for(unsigned x = 0; x < X_SIZE; x++)
-         {
-            uint8_t c    = cell[x][y];
-            uint8_t peg  = c & 0x0F;
-            uint8_t hole = (c & 0xF0) >> 4;
-
-            if(peg != 0)
-            {
-               win.fgcolour(peg);
-               win.addch('o');
-            }
-            else if(hole != 0)
-            {
-               win.fgcolour(hole);
-               win.addch('.');
-            }
-            else
-            {
-               win.fgcolour(7);
-               win.addch(' ');
-            }
-         }
-         win.addch('\n');
-      }
-   }
-
-private:
-   static bool getXY(const Pos60& pos, unsigned& x, unsigned& y)
-   {
-      x = OFFSET_X + pos.getX();
-      y = OFFSET_Y - pos.getY();
+      if(action[hole] == shown_action[hole]) return;
 
-      return (x < X_SIZE) && (y < Y_SIZE);
-   }
+      shown_action[hole] = action[hole];
 
-   void setCell(const Pos60& pos, uint8_t mask, uint8_t value)
-   {
       unsigned x, y;
-      if(getXY(pos, x, y))
+      getXY(HoleTable<N>::getPos(hole), x, y);
+
+      char lch{}, rch{};
+
+      x += offset_x;
+      y += offset_y;
+
+      switch(action[hole])
       {
-         cell[x][y] = (cell[x][y] & mask) | value;
+      case ACT_NONE: lch = ' '; rch = ' '; break;
+      case ACT_PICK: lch = '<'; rch = '>'; break;
+      case ACT_HOP:  lch = '['; rch = ']'; break;
+      case ACT_DROP: lch = '>'; rch = '<'; break;
       }
-   }
 
-   const uint8_t getCell(const Pos60& pos) const
-   {
-      unsigned x, y;
-      return getXY(pos, x, y) ? cell[x][y] : INVALID;
+      setColour(7);
+      win.mvaddch(y, x - 1, lch);
+      win.mvaddch(y, x + 1, rch);
    }
 
-   static const uint8_t INVALID = 0x00;
-   static const uint8_t EMPTY   = 0x70;
+   static const uint8_t UNKNOWN = 0xFF;
 
    static const unsigned OFFSET_X = N * 3;
    static const unsigned OFFSET_Y = N * 2;
@@ -245,9 +189,14 @@ private:
    static const unsigned X_SIZE = OFFSET_X * 2 + 1;
    static const unsigned Y_SIZE = OFFSET_Y * 2 + 1;
 
-   TRM::Curses& win;
-   unsigned     offset_x, offset_y;
-   uint8_t      cell[X_SIZE][Y_SIZE];
+   WINDOW&         win;
+   BoardState<N>&  state;
+   unsigned        offset_x, offset_y;
+   uint8_t         colour{UNKNOWN};
+   Bitboard<N>     dirty;                                 //!< Holes to check on next refresh
+   uint8_t         shown[HoleTable<N>::NUM_HOLES];        //!< Hole as drawn on the screen
+   Action          action[HoleTable<N>::NUM_HOLES];       //!< Action marker wanted
+   Action          shown_action[HoleTable<N>::NUM_HOLES]; //!< Action marker on the screen
 };
 
 #endif
@@ -0,0 +1,342 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef BOARD_STATE_H
+#define BOARD_STATE_H
+
+#include <cassert>
+#include <cstdint>
+
+#include "Bitboard.h"
+#include "DistTable.h"
+#include "Hole.h"
+#include "Nnue.h"
+#include "Pos60.h"
+#include "Zobrist.h"
+
+
+enum Action : char
+{
+   ACT_NONE,
+   ACT_PICK,
+   ACT_HOP,
+   ACT_DROP
+};
+
+
+//! Interface for a view of a board that wants to know when it changes
+class BoardObserver
+{
+public:
+   //! The contents of a single hole has changed
+   virtual void holeChanged(Hole hole) = 0;
+
+   //! Every hole may have changed
+   virtual void boardChanged() = 0;
+
+   //! Show (or with ACT_NONE remove) an action marker around a hole
+   virtual void showAction(Hole hole, Action action) = 0;
+};
+
+
+//! State of the holes on a size N board, without any presentation
+//
+//  An observer may be attached to follow changes. The observer is not part
+//  of the value of the board, so copies of an observed board start out
+//  unobserved and can be modified freely without any drawing.
+//
+//  A Zobrist key for the pegs and the player to move, the number of steps
+//  each player still needs to get home and, when network weights are
+//  loaded, the network accumulator are kept up to date as the board changes.
+//  A whole move can be made and later taken back, which restores all of
+//  these exactly without copying the board.
+template <unsigned N>
+class BoardState
+{
+public:
+   BoardState()
+   {
+      clear();
+   }
+
+   void setObserver(BoardObserver* observer_) { observer.ptr = observer_; }
+
+   bool isEmpty(Hole hole) const
+   {
+      return cell[hole] != INVALID && (cell[hole] & 0x0F) == 0;
+   }
+
+   bool isOccupied(Hole hole) const
+   {
+      return (cell[hole] & 0x0F) != 0;
+   }
+
+   bool isPegHome(Hole peg_hole) const
+   {
+      uint8_t player = cell[peg_hole] & 0x0F;
+      return (cell[peg_hole] >> 4) == player;
+   }
+
+   //! Player with a peg in a hole, or zero
+   unsigned getPeg(Hole hole) const { return cell[hole] & 0x0F; }
+
+   //! Player whose home triangle a hole is part of, or seven for the middle
+   unsigned getHome(Hole hole) const { return cell[hole] >> 4; }
+
+   //! Check if all the pegs for a player are in their home triangle
+   bool arePegsHome(unsigned player) const
+   {
+      return (pegs[player] & ~homes[player]).none();
+   }
+
+   //! All the pegs for one player
+   const Bitboard<N>& getPegs(unsigned player) const { return pegs[player]; }
+
+   //! Holes in a player's home triangle
+   const Bitboard<N>& getHomeHoles(unsigned player) const { return homes[player]; }
+
+   //! All holes with a peg from any player
+   const Bitboard<N>& getOccupied() const { return occupied; }
+
+   //! All holes that are not occupied
+   Bitboard<N> getEmpty() const { return valid & ~occupied; }
+
+   //! Player whose turn it is, or zero
+   unsigned getSideToMove() const { return side_to_move; }
+
+   void setSideToMove(unsigned player)
+   {
+      key ^= Zobrist<N>::side(side_to_move) ^ Zobrist<N>::side(player);
+
+      side_to_move = player;
+   }
+
+   //! Hash key for the position
+   uint64_t getKey() const { return key; }
+
+   //! Total over a player's pegs of the steps to the player's target corner
+   //  and the steps to the player's home triangle
+   unsigned getSteps(unsigned player) const { return steps[player]; }
+
+   //! First layer of the evaluation network, only valid if Nnue is loaded
+   const typename Nnue<N>::Accumulator& getAccumulator() const { return accumulator; }
+
+   //! Hash key for the position computed from scratch, for checking getKey()
+   uint64_t computeKey() const
+   {
+      uint64_t k = Zobrist<N>::side(side_to_move);
+
+      for(unsigned player = 1; player <= 6; player++)
+      {
+         pegs[player].forEach([&k, player](unsigned bit)
+                              {
+                                 k ^= Zobrist<N>::peg(HoleTable<N>::getHole(bit), player);
+                              });
+      }
+
+      return k;
+   }
+
+   //! Holes that can be reached by a single step in direction dir
+   Bitboard<N> stepTargets(const Bitboard<N>& from, Dir60 dir) const
+   {
+      return from.shift(dir) & getEmpty();
+   }
+
+   //! Holes that can be reached by a single hop in direction dir
+   Bitboard<N> hopTargets(const Bitboard<N>& from, Dir60 dir) const
+   {
+      return (from.shift(dir) & occupied).shift(dir) & getEmpty();
+   }
+
+   void setEmpty(Hole hole)
+   {
+      assert(isOccupied(hole));
+
+      unsigned bit    = HoleTable<N>::getBit(hole);
+      unsigned player = cell[hole] & 0x0F;
+      pegs[player].reset(bit);
+      occupied.reset(bit);
+
+      key ^= Zobrist<N>::peg(hole, player);
+
+      steps[player] -= pegSteps(hole, player);
+
+      if(Nnue<N>::isLoaded()) Nnue<N>::sub(accumulator, hole, player);
+
+      cell[hole] &= 0xF0;
+
+      if(observer.ptr != nullptr) observer.ptr->holeChanged(hole);
+   }
+
+   void setPeg(Hole hole, unsigned player)
+   {
+      assert(isEmpty(hole));
+
+      unsigned bit = HoleTable<N>::getBit(hole);
+      pegs[player].set(bit);
+      occupied.set(bit);
+
+      key ^= Zobrist<N>::peg(hole, player);
+
+      steps[player] += pegSteps(hole, player);
+
+      if(Nnue<N>::isLoaded()) Nnue<N>::add(accumulator, hole, player);
+
+      cell[hole] = (cell[hole] & 0xF0) | uint8_t(player);
+
+      if(observer.ptr != nullptr) observer.ptr->holeChanged(hole);
+   }
+
+   //! Record of a move made with makeMove() to take it back with unmakeMove()
+   struct Undo
+   {
+      Hole     start;
+      Hole     end;
+      uint8_t  player;
+      uint8_t  side_to_move;
+      uint64_t key;          //!< Key before the move, for checking
+   };
+
+   //! Move the peg in hole start to hole end and pass the turn to next_side
+   Undo makeMove(Hole start, Hole end, unsigned next_side)
+   {
+      Undo undo{start, end, uint8_t(getPeg(start)), uint8_t(side_to_move), key};
+
+      setEmpty(start);
+      setPeg(end, undo.player);
+      setSideToMove(next_side);
+
+      return undo;
+   }
+
+   //! Take back the last move made with makeMove()
+   void unmakeMove(const Undo& undo)
+   {
+      setSideToMove(undo.side_to_move);
+      setEmpty(undo.end);
+      setPeg(undo.start, undo.player);
+
+      assert(key == undo.key);
+   }
+
+   //! Show an action on the board, only visible if the board is observed
+   void showAction(Hole hole, Action action) const
+   {
+      if(observer.ptr != nullptr) observer.ptr->showAction(hole, action);
+   }
+
+   //! Remove all pegs and mark out the home triangles
+   void clear()
+   {
+      key          = 0;
+      side_to_move = 0;
+
+      Nnue<N>::reset(accumulator);
+
+      valid.clear();
+      occupied.clear();
+
+      for(unsigned player = 0; player <= 6; player++)
+      {
+         pegs[player].clear();
+         homes[player].clear();
+         steps[player] = 0;
+      }
+
+      for(Hole hole = 0; hole < HoleTable<N>::NUM_HOLES; hole++)
+      {
+         cell[hole] = EMPTY;
+         valid.set(HoleTable<N>::getBit(hole));
+      }
+
+      cell[HoleTable<N>::NONE] = INVALID;
+
+      for(unsigned player = 1; player <= 6; player++)
+      {
+         Dir60 dir(player + 2);
+         Pos60 row(dir, N);
+
+         dir.rotLeft();
+         row.move(dir);
+
+         Dir60 across = dir;
+         across.rotLeft();
+
+         for(unsigned j = N; j >= 1; j--)
+         {
+            Pos60 pos = row;
+
+            for(unsigned k = 0; k < j; k++)
+            {
+               setHome(HoleTable<N>::getHole(pos), player);
+
+               pos.move(across);
+            }
+
+            row.move(dir);
+         }
+      }
+
+      if(observer.ptr != nullptr) observer.ptr->boardChanged();
+   }
+
+private:
+   //! Observer reference that is left behind when the board is copied
+   class ObserverRef
+   {
+   public:
+      ObserverRef() = default;
+      ObserverRef(const ObserverRef&) {}
+      ObserverRef& operator=(const ObserverRef&) { return *this; }
+
+      BoardObserver* ptr{nullptr};
+   };
+
+   static unsigned pegSteps(Hole hole, unsigned player)
+   {
+      return DistTable<N>::toTarget(hole, player) + DistTable<N>::toHome(hole, player);
+   }
+
+   void setHome(Hole hole, unsigned player)
+   {
+      homes[player].set(HoleTable<N>::getBit(hole));
+
+      cell[hole] = (cell[hole] & 0x0F) | uint8_t(player << 4);
+   }
+
+   static const uint8_t INVALID = 0x00;
+   static const uint8_t EMPTY   = 0x70;
+
+   uint8_t                       cell[HoleTable<N>::NUM_HOLES + 1];
+   Bitboard<N>                   valid;    //!< All the holes
+   Bitboard<N>                   occupied; //!< Holes with a peg from any player
+   Bitboard<N>                   pegs[7];  //!< Holes with a peg for each player
+   Bitboard<N>                   homes[7]; //!< Home triangle for each player
+   unsigned                      side_to_move;
+   uint64_t                      key;
+   unsigned                      steps[7];
+   typename Nnue<N>::Accumulator accumulator;
+   ObserverRef                   observer;
+};
+
+#endif
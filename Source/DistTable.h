@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef DIST_TABLE_H
+#define DIST_TABLE_H
+
+#include <cstdint>
+
+#include "Hole.h"
+
+//! Compile time tables of how far each hole is from each player's home
+//
+//  Distances are counted in single steps around the shape of the board,
+//  so they are exact for a peg moving on an otherwise empty board. The
+//  target for a player is the far corner of their home triangle, that
+//  all of the player's pegs head for. Player zero has zero distances so
+//  it can be used without checking.
+template <unsigned N>
+class DistTable
+{
+public:
+   //! Hole at the far corner of a player's home triangle
+   static Hole target(unsigned player) { return table.target[player]; }
+
+   //! Steps from a hole to a player's target corner
+   static unsigned toTarget(Hole hole, unsigned player) { return table.to_target[hole][player]; }
+
+   //! Steps from a hole to the nearest hole in a player's home triangle
+   static unsigned toHome(Hole hole, unsigned player) { return table.to_home[hole][player]; }
+
+   //! Squared straight line distance from a hole to a player's target corner
+   static unsigned distSquared(Hole hole, unsigned player) { return table.dist_squared[hole][player]; }
+
+private:
+   static const unsigned NUM_HOLES = HoleTable<N>::NUM_HOLES;
+
+   struct Table
+   {
+      uint8_t  to_target[NUM_HOLES + 1][7]{};
+      uint8_t  to_home[NUM_HOLES + 1][7]{};
+      uint32_t dist_squared[NUM_HOLES + 1][7]{};
+      Hole     target[7]{};
+   };
+
+   static constexpr unsigned steps(signed x1, signed y1, signed x2, signed y2)
+   {
+      unsigned delta_x = x2 > x1 ? x2 - x1 : x1 - x2;
+      unsigned delta_y = y2 > y1 ? y2 - y1 : y1 - y2;
+
+      return delta_x > delta_y ? delta_y + (delta_x - delta_y) / 2 : delta_y;
+   }
+
+   //! Breadth first search out from the holes with a zero distance
+   static constexpr void spread(uint8_t (&dist)[NUM_HOLES + 1][7], unsigned player)
+   {
+      Hole     queue[NUM_HOLES]{};
+      unsigned head = 0;
+      unsigned tail = 0;
+
+      for(Hole hole = 0; hole < NUM_HOLES; hole++)
+      {
+         if(dist[hole][player] == 0) queue[tail++] = hole;
+      }
+
+      while(head < tail)
+      {
+         Hole hole = queue[head++];
+
+         for(unsigned d = 0; d < 6; d++)
+         {
+            Hole next = HoleTable<N>::neighbourIndex(hole, d);
+
+            if((next != HoleTable<N>::NONE) && (dist[next][player] == 0xFF))
+            {
+               dist[next][player] = dist[hole][player] + 1;
+               queue[tail++]      = next;
+            }
+         }
+      }
+   }
+
+   static constexpr Table build()
+   {
+      Table t{};
+
+      // Directions in Dir60 index order 30, 90, 150, 210, 270, 330
+      const signed dx[6] = {+1, +2, +1, -1, -2, -1};
+      const signed dy[6] = {+1,  0, -1, -1,  0, +1};
+
+      for(unsigned player = 1; player <= 6; player++)
+      {
+         // Same corner as two sides of the home triangle from the centre
+         // (must match BoardState::clear())
+         unsigned back = (player + 2) % 6;
+         unsigned side = (player + 1) % 6;
+         signed   x    = signed(N) * (dx[back] + dx[side]);
+         signed   y    = signed(N) * (dy[back] + dy[side]);
+
+         for(Hole hole = 0; hole < NUM_HOLES; hole++)
+         {
+            signed   delta_x = HoleTable<N>::getX(hole) - x;
+            signed   delta_y = HoleTable<N>::getY(hole) - y;
+            unsigned corner  = steps(x, y, HoleTable<N>::getX(hole), HoleTable<N>::getY(hole));
+
+            if(corner == 0) t.target[player] = hole;
+
+            // The home triangle is every hole within N-1 steps of the corner
+            t.to_target[hole][player]    = corner == 0 ? 0 : 0xFF;
+            t.to_home[hole][player]      = corner < N ? 0 : 0xFF;
+            t.dist_squared[hole][player] = delta_x * delta_x + delta_y * delta_y * 3;
+         }
+
+         spread(t.to_target, player);
+         spread(t.to_home, player);
+      }
+
+      return t;
+   }
+
+   static const Table table;
+};
+
+template <unsigned N>
+constexpr typename DistTable<N>::Table DistTable<N>::table = DistTable<N>::build();
+
+#endif
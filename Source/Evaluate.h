@@ -0,0 +1,108 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include <cstdlib>
+
+#include "BoardState.h"
+#include "DistTable.h"
+#include "Hole.h"
+#include "Move.h"
+#include "Nnue.h"
+#include "Pos60.h"
+#include "Stats.h"
+
+//! Heuristic scoring of moves and positions
+template <unsigned N>
+class Evaluate
+{
+public:
+   //! Score for a move by one of a player's pegs, higher is better and always non-zero
+   static unsigned move(unsigned player, const Move<N>& move)
+   {
+      Stats::count(STAT_MOVE_SCORES);
+
+      unsigned dist_before = DistTable<N>::distSquared(move.getStart(), player);
+      unsigned dist_after  = DistTable<N>::distSquared(move.getEnd(), player);
+
+      return 1000000 + dist_before - dist_after;
+   }
+
+   //! Number of single steps still needed to bring all of a player's pegs home
+   //  Each peg counts the steps to the player's target corner, and pegs that
+   //  are not home yet also count the steps to the home triangle. Both are
+   //  kept up to date by the board. Once only a few pegs are left outside,
+   //  they count the steps to the nearest home hole without one of the
+   //  player's pegs in it instead, so that they are drawn to the gaps.
+   //
+   //  When network weights are loaded the network output is used instead
+   static unsigned distance(const BoardState<N>& state, unsigned player)
+   {
+      Stats::count(STAT_EVALUATIONS);
+
+      if(Nnue<N>::isLoaded()) return Nnue<N>::evaluate(state.getAccumulator(), player);
+
+      unsigned total = state.getSteps(player);
+
+      Bitboard<N> outside = state.getPegs(player) & ~state.getHomeHoles(player);
+
+      if(outside.count() > GAP_PEGS) return total;
+
+      Bitboard<N> gaps = state.getHomeHoles(player) & ~state.getPegs(player);
+
+      outside.forEach([&](unsigned bit)
+                      {
+                         Pos60    pos     = Bitboard<N>::getPos(bit);
+                         unsigned nearest = ~0u;
+
+                         gaps.forEach([&](unsigned gap)
+                                      {
+                                         unsigned n = steps(pos, Bitboard<N>::getPos(gap));
+                                         if(n < nearest) nearest = n;
+                                      });
+
+                         unsigned to_home = DistTable<N>::toHome(HoleTable<N>::getHole(bit), player);
+
+                         if(nearest > to_home) total += nearest - to_home;
+                      });
+
+      return total;
+   }
+
+private:
+   //! Pegs outside home at most for which the gaps in the home are looked for
+   //  (the number of gaps is the same as the number of pegs outside)
+   static const unsigned GAP_PEGS = 3;
+
+   //! Number of single steps between two positions on an empty board
+   static unsigned steps(const Pos60& from, const Pos60& to)
+   {
+      unsigned delta_x = std::abs(to.getX() - from.getX());
+      unsigned delta_y = std::abs(to.getY() - from.getY());
+
+      return delta_x > delta_y ? delta_y + (delta_x - delta_y) / 2 : delta_y;
+   }
+};
+
+#endif
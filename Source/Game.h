@@ -23,21 +23,60 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 #include "STB/Option.h"
 
 #include "Board.h"
 #include "Player.h"
+#include "Stats.h"
+#include "Thinker.h"
+#include "TimeManager.h"
+#include "Trace.h"
 
 
 struct GameOptions
 {
-   STB::Option<unsigned> num_players{  'p', "players", "Number of players", 2};
-   STB::Option<unsigned> size{         's', "size",    "Size (3..9)", 5};
-   STB::Option<unsigned> speed{        'T', "speed",   "Speed of play (ms)", 500};
-   STB::Option<unsigned> human_players{'H', "humans",  "Number of humans", 0};
+   STB::Option<unsigned>    num_players{  'p', "players", "Number of players", 2};
+   STB::Option<unsigned>    size{         's', "size",    "Size (3..9)", 5};
+   STB::Option<unsigned>    speed{        'T', "speed",   "Speed of play (ms)", 500};
+   STB::Option<unsigned>    human_players{'H', "humans",  "Number of humans", 0};
+   STB::Option<bool>        hop_closure{  'c', "closure", "Find one chain of hops to each hole", false};
+   STB::Option<unsigned>    depth{        'd', "depth",   "Search depth (0 for greedy)", 0};
+   STB::Option<unsigned>    nodes{        'n', "nodes",   "Search node limit (0 for none)", 0};
+   STB::Option<unsigned>    movetime{     'y', "movetime", "Thinking time for each computer move (ms, 0 to follow --speed)", 0};
+   STB::Option<unsigned>    clock{        'k', "clock",   "Thinking time for each computer player for a game (s, 0 for none)", 0};
+   STB::Option<unsigned>    multi{        'm', "multi",   "Search for 3+ players (0 paranoid, 1 best reply, 2 max^n)", 1};
+   STB::Option<unsigned>    mcts{         'u', "mcts",    "Monte Carlo tree search playouts (0 for none)", 0};
+   STB::Option<unsigned>    threads{      't', "threads", "Search threads, or game threads with --batch", 1};
+   STB::Option<unsigned>    hash{         'M', "hash",    "Transposition table size (MB)", 16};
+   STB::Option<const char*> weights{      'w', "weights", "Network weights file for evaluation", ""};
+   STB::Option<unsigned>    batch{        'b', "batch",   "Play this many games without a terminal and report", 0};
+   STB::Option<unsigned>    seed{         'S', "seed",    "Seed for the random opening moves of batch games", 1};
+   STB::Option<unsigned>    perft{        'P', "perft",   "Count positions to this depth without a terminal and report", 0};
+   STB::Option<bool>        divide{       'D', "divide",  "Show the perft count after each first move", false};
+   STB::Option<bool>        all_paths{    'a', "paths",   "Perft counts every chain of hops, not one per peg and hole", false};
+   STB::Option<bool>        audit{        'A', "audit",   "Check kept moves against finding all moves", false};
+   STB::Option<const char*> trace{        'R', "trace",   "Write a Chrome trace of where the time goes to this file", ""};
+   STB::Option<bool>        stats{        'x', "stats",   "Show the work done each turn and game, as JSON lines with --batch", false};
 };
 
 
+//! Load the network weights file, if there is one, for a size SIZE board
+//  Without one evaluation counts steps. Returns false, after reporting it,
+//  if the file can't be used
+template <unsigned SIZE>
+bool loadWeights(const GameOptions& options)
+{
+   if((options.weights[0] == '\0') || Nnue<SIZE>::load(options.weights)) return true;
+
+   fprintf(stderr, "ERROR: failed to load network weights \"%s\"\n", (const char*)options.weights);
+   return false;
+}
+
+
 template <unsigned SIZE> class Game
 {
 public:
@@ -50,36 +89,73 @@ public:
 
    TRM::Curses&       win;
    const GameOptions& options;
+   BoardState<SIZE>   state;
    Board<SIZE>        board;
+   MoveGen<SIZE>      move_gen;
+   TransTable         trans_table;
+   Search<SIZE>       search;
+   Mcts<SIZE>         mcts;
    Player<SIZE>       players[6];
    int8_t             ch{'\0'};
    unsigned           i{0};
    unsigned           turn{0};
    Mode               mode{START_GAME};
+   StatCounts         game_start;
+   StatCounts         turn_start;
+   bool               polling{false};
+   TimeManager        time_manager;
+   Thinker            thinker;   //!< Last, so it stops before anything it uses goes
 
    Game(TRM::Curses& win_, const GameOptions& options_)
       : win(win_)
       , options(options_)
-      , board(win_)
-   {}
+      , board(win_, state)
+      , search(trans_table)
+   {
+      move_gen.setAudit(options.audit);
+      trans_table.resize(options.hash);
+      search.setThreads(options.threads);
+      mcts.setThreads(options.threads);
+
+      // Without a time set, a move may take as long as a few animation frames
+      time_manager.setClock(options.clock * 1000);
+      time_manager.setMoveTime(options.movetime != 0 ? unsigned(options.movetime)
+                                                     : options.speed * SPEED_MOVE_FRAMES);
+   }
 
    bool iterate()
    {
+      static const char* const phase[] = {"START_GAME", "START_TURN", "MID_TURN"};
+
+      Trace::Span span(phase[mode]);
+
       char text[16];
 
       switch(mode)
       {
       case START_GAME:
-         board.clear();
+         thinker.cancel();
+
+         state.clear();
+         trans_table.clear();
+         time_manager.reset();
 
          for(i = 0; i < options.num_players; i++)
          {
-            players[i].initialise(board, 1 + i * (6.0 / options.num_players),
+            players[i].initialise(state, move_gen, trans_table, 1 + i * (6.0 / options.num_players),
                                   i < options.human_players);
+            players[i].setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+            players[i].setSearch(isSearching() ? &search : nullptr, limits());
+            players[i].setMcts(options.mcts != 0 ? &mcts : nullptr, options.mcts);
+            players[i].setTimeManager(&time_manager);
+            players[i].setThinker(&thinker);
          }
 
-         turn = 0;
-         i    = 0;
+         startSearch();
+
+         turn       = 0;
+         i          = 0;
+         game_start = Stats::total();
 
          win.timeout(options.speed);
 
@@ -87,15 +163,35 @@ public:
          break;
 
       case START_TURN:
+         state.setSideToMove(players[i].getId());
+
          snprintf(text, sizeof(text), "Player %d", i + 1);
          win.mvaddstr(1, win.cols - 15, text);
 
          snprintf(text, sizeof(text), "%3u", ++turn);
          win.mvaddstr(1, win.cols - 3, text);
 
+         turn_start = Stats::total();
+
+         if(players[i].isHuman())
+         {
+            // Wait for key presses
+            win.timeout(0);
+
+            // Meanwhile the next player can think about a reply
+            players[(i + 1) % options.num_players].ponder(state);
+         }
+
       case MID_TURN:
-         if(players[i].takeATurn(mode == START_TURN, ch))
+         if(takeATurn())
          {
+            if(options.stats) showStats();
+
+            if(players[i].isHuman())
+            {
+               win.timeout(options.speed);
+            }
+
             if(players[i].areAllPegsHome())
             {
                win.timeout(0);
@@ -114,10 +210,111 @@ public:
          break;
       }
 
-      ch = win.getch();
+      // Keep checking for keys while a computer player thinks
+      if(players[i].isThinking() != polling)
+      {
+         polling = !polling;
+         win.timeout(polling ? THINKING_POLL : options.speed);
+      }
+
+      board.refresh();
+
+      {
+         Trace::Span wait("getch");
+
+         ch = win.getch();
+      }
+
       return (ch != -1) && (ch != 'q');
    }
 
+   //! Current player takes the next step of a turn
+   //  With no delay between frames, a computer player's move is made in one go
+   bool takeATurn()
+   {
+      bool start_turn  = mode == START_TURN;
+      bool all_at_once = (options.speed == 0) && !players[i].isHuman();
+
+      while(true)
+      {
+         bool done = players[i].takeATurn(start_turn, ch);
+
+         if(done || !all_at_once || players[i].isThinking()) return done;
+
+         start_turn = false;
+      }
+   }
+
+   //! Time between checks for keys while a computer player thinks (ms)
+   static const unsigned THINKING_POLL = 20;
+
+   //! Frames of --speed that a computer move may think for, without --movetime
+   static const unsigned SPEED_MOVE_FRAMES = 4;
+
+   //! Show the work done for the last computer turn and so far this game
+   //  on the bottom two lines
+   void showStats()
+   {
+      StatCounts now = Stats::total();
+
+      if(!players[i].isHuman())
+      {
+         showStatsLine(win.lines - 2, "turn", now - turn_start);
+      }
+
+      showStatsLine(win.lines - 1, "game", now - game_start);
+   }
+
+   void showStatsLine(unsigned line, const char* label, const StatCounts& counts)
+   {
+      char     text[256];
+      unsigned width = std::min(unsigned(win.cols), unsigned(sizeof(text) - 1));
+
+      counts.format(label, text, width + 1);
+
+      // Pad to the full width so nothing is left of a longer line
+      unsigned length = strlen(text);
+      memset(text + length, ' ', width - length);
+      text[width] = '\0';
+
+      win.mvaddstr(line, 0, text);
+   }
+
+   //! Computer players search ahead unless no limit is set
+   bool isSearching() const
+   {
+      return (options.depth != 0) || (options.nodes != 0) ||
+             (options.movetime != 0) || (options.clock != 0);
+   }
+
+   typename Search<SIZE>::Limits limits() const
+   {
+      typename Search<SIZE>::Limits limits;
+
+      limits.depth = options.depth;
+      limits.nodes = options.nodes;
+
+      return limits;
+   }
+
+   //! Tell the search who is playing
+   void startSearch()
+   {
+      unsigned order[6];
+
+      for(unsigned p = 0; p < options.num_players; p++)
+      {
+         order[p] = players[p].getId();
+      }
+
+      search.setPlayers(order, options.num_players);
+      search.setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+      mcts.setPlayers(order, options.num_players);
+      mcts.setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+
+      search.setMode(options.multi <= SEARCH_MAXN ? SearchMode(unsigned(options.multi)) : SEARCH_PARANOID);
+   }
+
    static bool doIterate(void* that)
    {
       return reinterpret_cast<Game<SIZE>*>(that)->iterate();
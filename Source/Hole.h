@@ -0,0 +1,173 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef HOLE_H
+#define HOLE_H
+
+#include <cstdint>
+
+#include "Bitboard.h"
+#include "Pos60.h"
+
+//! Dense index of a hole on the board 0..HoleTable<N>::NUM_HOLES-1
+using Hole = uint16_t;
+
+//! Compile time tables describing the holes on a size N board
+//
+//  Holes are numbered row by row from the top of the board, left to right.
+//  The index NONE is used for anything off the board, and has its own entry
+//  in the neighbour and jump tables (that leads back to NONE) so that
+//  lookups can be chained without checking for it.
+template <unsigned N>
+class HoleTable
+{
+public:
+   static const unsigned NUM_HOLES = 6 * N * (N + 1) + 1;
+   static const Hole     NONE      = NUM_HOLES;
+
+   //! Adjacent hole in direction dir
+   static Hole neighbour(Hole hole, Dir60 dir) { return table.neighbour[hole][dir.getIndex()]; }
+
+   //! Landing hole for a hop in direction dir
+   static Hole jump(Hole hole, Dir60 dir) { return table.jump[hole][dir.getIndex()]; }
+
+   //! Bitboard bit for a hole
+   static unsigned getBit(Hole hole) { return table.bit[hole]; }
+
+   //! Hole for a bitboard bit
+   static Hole getHole(unsigned bit) { return table.hole[bit]; }
+
+   //! Hole at a position, NONE if not on the board
+   static Hole getHole(const Pos60& pos)
+   {
+      unsigned bit;
+      return Bitboard<N>::getBit(pos, bit) ? table.hole[bit] : NONE;
+   }
+
+   //! Position of a hole
+   static Pos60 getPos(Hole hole) { return Pos60(table.x[hole], table.y[hole]); }
+
+   //! Coordinates of a hole and its neighbour by direction index, these
+   //  can be used to build other compile time tables
+   static constexpr signed getX(Hole hole) { return table.x[hole]; }
+   static constexpr signed getY(Hole hole) { return table.y[hole]; }
+
+   static constexpr Hole neighbourIndex(Hole hole, unsigned dir_index)
+   {
+      return table.neighbour[hole][dir_index];
+   }
+
+private:
+   static const unsigned BITS = Bitboard<N>::SIZE;
+
+   struct Table
+   {
+      int8_t   x[NUM_HOLES + 1]{};
+      int8_t   y[NUM_HOLES + 1]{};
+      uint16_t bit[NUM_HOLES + 1]{};
+      Hole     neighbour[NUM_HOLES + 1][6]{};
+      Hole     jump[NUM_HOLES + 1][6]{};
+      Hole     hole[BITS]{};
+   };
+
+   //! Axial (q, r) bit index for a position or BITS if off the grid
+   static constexpr unsigned bitOf(signed x, signed y)
+   {
+      signed q = (x - y) / 2 + signed(2 * N);
+      signed r = y + signed(2 * N);
+
+      if((q < 0) || (r < 0) || (q >= signed(Bitboard<N>::ROW)) || (r >= signed(Bitboard<N>::ROW)))
+      {
+         return BITS;
+      }
+
+      return r * Bitboard<N>::WIDTH + q;
+   }
+
+   static constexpr Table build()
+   {
+      Table t{};
+
+      for(unsigned b = 0; b < BITS; b++)
+      {
+         t.hole[b] = NONE;
+      }
+
+      // Rows from the top of the board, 'n' is the number of holes in a row
+      // (must match Board::clear())
+      const unsigned y_size = N * 4 + 1;
+
+      Hole h = 0;
+
+      for(unsigned row = 0; row < y_size; row++)
+      {
+         unsigned n = 0;
+
+              if (row <  N)        n =      row + 1;
+         else if (row < (N*2 + 1)) n = y_size - row;
+         else if (row < (N*3 + 1)) n =      row + 1;
+         else                      n = y_size - row;
+
+         signed x = signed(N * 3 + 1 - n) - signed(N * 3);
+         signed y = signed(N * 2) - signed(row);
+
+         for(unsigned i = 0; i < n; i++)
+         {
+            t.x[h]              = int8_t(x);
+            t.y[h]              = int8_t(y);
+            t.bit[h]            = uint16_t(bitOf(x, y));
+            t.hole[bitOf(x, y)] = h;
+
+            h++;
+            x += 2;
+         }
+      }
+
+      // Directions in Dir60 index order 30, 90, 150, 210, 270, 330
+      const signed dx[6] = {+1, +2, +1, -1, -2, -1};
+      const signed dy[6] = {+1,  0, -1, -1,  0, +1};
+
+      for(unsigned d = 0; d < 6; d++)
+      {
+         t.neighbour[NONE][d] = NONE;
+         t.jump[NONE][d]      = NONE;
+
+         for(h = 0; h < NUM_HOLES; h++)
+         {
+            unsigned b1 = bitOf(t.x[h] + dx[d],     t.y[h] + dy[d]);
+            unsigned b2 = bitOf(t.x[h] + dx[d] * 2, t.y[h] + dy[d] * 2);
+
+            t.neighbour[h][d] = b1 < BITS ? t.hole[b1] : NONE;
+            t.jump[h][d]      = b2 < BITS ? t.hole[b2] : NONE;
+         }
+      }
+
+      return t;
+   }
+
+   static const Table table;
+};
+
+template <unsigned N>
+constexpr typename HoleTable<N>::Table HoleTable<N>::table = HoleTable<N>::build();
+
+#endif
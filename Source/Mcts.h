@@ -0,0 +1,460 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BoardState.h"
+#include "Evaluate.h"
+#include "Move.h"
+#include "MoveGen.h"
+#include "Random.h"
+#include "Trace.h"
+
+//! Monte Carlo tree search for the player to move
+//
+//  UCT where each node keeps the sum of the results of its playouts for
+//  every player, and each player picks the child that is best for
+//  themselves. Playouts use the greedy policy with a small chance of a
+//  random move, on unobserved copies of the board so nothing is drawn.
+//
+//  Several threads may grow the same tree. A thread counts a visit to each
+//  node on its way down and only adds the result on the way back up, so
+//  that until then the node looks worse to the other threads (a virtual
+//  loss). Nodes come from a pool allocated once, so searching never
+//  allocates.
+template <unsigned N>
+class Mcts
+{
+public:
+   static const unsigned DEFAULT_POOL = 1 << 20;
+
+   //! Set the players in the order they take turns
+   void setPlayers(const unsigned* player, unsigned num_players_)
+   {
+      num_players = num_players_;
+
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         order[i]         = player[i];
+         index[player[i]] = i;
+      }
+   }
+
+   void setHopMode(HopMode hop_mode_) { hop_mode = hop_mode_; }
+
+   //! Number of threads growing the tree
+   void setThreads(unsigned num_threads_) { num_threads = num_threads_ == 0 ? 1 : num_threads_; }
+
+   //! Seed for the random moves in playouts
+   void setSeed(uint64_t seed_) { seed = seed_; }
+
+   //! Number of nodes in the pool, takes effect at the next search
+   void setPoolSize(unsigned nodes) { pool_size = nodes; pool.reset(); }
+
+   //! Find the best move for the player to move with a number of playouts
+   //  and, if time_ms is not zero, stopping after that time. The first
+   //  playout is always finished, however short the time
+   //  Returns false if there are no moves. If stopped before the first
+   //  playout, the best ordered move is returned
+   bool run(const BoardState<N>& state, unsigned playouts, Move<N>& best_move, unsigned time_ms = 0)
+   {
+      Trace::Span span("Mcts::run");
+
+      if(!pool) pool.reset(new Node[pool_size]);
+
+      if(workers.size() != num_threads)
+      {
+         workers.clear();
+
+         for(unsigned i = 0; i < num_threads; i++)
+         {
+            workers.emplace_back(new Worker);
+         }
+      }
+
+      resetNode(pool[0], 0, index[state.getSideToMove()]);
+      pool_used.store(1, std::memory_order_relaxed);
+      started.store(0, std::memory_order_relaxed);
+      stopping.store(false, std::memory_order_relaxed);
+      budget   = playouts;
+      deadline = Clock::now() + std::chrono::milliseconds(time_ms);
+      timed    = time_ms != 0;
+
+      std::vector<std::thread> threads;
+
+      for(unsigned i = 1; i < num_threads; i++)
+      {
+         workers[i]->random.seed(seed + i);
+
+         threads.emplace_back([this, &state, i]() { grow(*workers[i], state); });
+      }
+
+      workers[0]->random.seed(seed);
+      grow(*workers[0], state);
+
+      for(auto& thread : threads)
+      {
+         thread.join();
+      }
+
+      // Play the most visited move
+      const Node& root = pool[0];
+      const Node* best = nullptr;
+
+      if(root.expanded.load(std::memory_order_acquire) == EXPANDED)
+      {
+         for(unsigned i = 0; i < root.num_children; i++)
+         {
+            const Node& child = pool[root.first_child + i];
+
+            if((best == nullptr) ||
+               (child.visits.load(std::memory_order_relaxed) > best->visits.load(std::memory_order_relaxed)))
+            {
+               best = &child;
+            }
+         }
+      }
+
+      if((best != nullptr) &&
+         MoveGen<N>::findMove(state, state.getSideToMove(), hop_mode, best->move, best_move))
+      {
+         return true;
+      }
+
+      // The root was never expanded, still make a move
+      MoveGen<N>& move_gen = workers[0]->move_gen;
+      unsigned    score;
+
+      move_gen.start(state, state.getSideToMove(), hop_mode);
+      move_gen.generateOrdered();
+
+      return move_gen.next(best_move, score);
+   }
+
+   //! Stop a search in progress, safe to call from another thread
+   //  The most visited move so far is still returned
+   void stop() { stopping.store(true, std::memory_order_relaxed); }
+
+   //! Playouts completed by the last search
+   unsigned getPlayouts() const { return pool[0].visits.load(std::memory_order_relaxed); }
+
+   //! Nodes used by the last search
+   unsigned getNodes() const
+   {
+      unsigned used = pool_used.load(std::memory_order_relaxed);
+      return used < pool_size ? used : pool_size;
+   }
+
+private:
+   static const unsigned MAX_DEPTH     = 128;
+   static const unsigned VALUE_SCALE   = 1024;     //!< Fixed point scale of results
+   static const unsigned RANDOM_MOVE   = 8;        //!< One in how many playout moves is random
+   static const unsigned EXPAND_VISITS = 4;        //!< Visits before a node is expanded
+
+   using Clock = std::chrono::steady_clock;
+
+   enum : uint8_t
+   {
+      UNEXPANDED,
+      EXPANDING,
+      EXPANDED,
+      LEAF        //!< Game over or the pool is full
+   };
+
+   struct Node
+   {
+      uint32_t              move{0};        //!< Packed move that leads to this node
+      uint32_t              first_child{0};
+      uint16_t              num_children{0};
+      uint8_t               mover{0};       //!< Index of the player to move
+      std::atomic<uint8_t>  expanded{UNEXPANDED};
+      std::atomic<uint32_t> visits{0};
+      std::atomic<uint64_t> value[6];       //!< Sum of results for each player, too big
+                                            //   for 32 bits after 4M playouts
+   };
+
+   //! State for each thread
+   struct Worker
+   {
+      MoveGen<N> move_gen;
+      Random     random;
+      Node*      path[MAX_DEPTH];
+      unsigned   result[6];
+   };
+
+   void resetNode(Node& node, uint32_t move, unsigned mover)
+   {
+      node.move         = move;
+      node.first_child  = 0;
+      node.num_children = 0;
+      node.mover        = mover;
+      node.expanded.store(UNEXPANDED, std::memory_order_relaxed);
+      node.visits.store(0, std::memory_order_relaxed);
+
+      for(auto& value : node.value)
+      {
+         value.store(0, std::memory_order_relaxed);
+      }
+   }
+
+   //! Run playouts until the budget is used up or the search is stopped
+   void grow(Worker& worker, const BoardState<N>& root_state)
+   {
+      for(unsigned count;
+          !stopping.load(std::memory_order_relaxed) &&
+          ((count = started.fetch_add(1, std::memory_order_relaxed)) < budget); )
+      {
+         // A playout takes far longer than looking at the clock. The first
+         // playout expands the root so it is always finished
+         if(timed && (count != 0) && (Clock::now() >= deadline))
+         {
+            stop();
+            break;
+         }
+
+         BoardState<N> state = root_state;
+         unsigned      depth = 0;
+         Node*         node  = &pool[0];
+
+         worker.path[depth++] = node;
+         node->visits.fetch_add(1, std::memory_order_relaxed);
+
+         bool game_over = false;
+
+         // Select down the tree
+         while(!game_over && (depth < MAX_DEPTH))
+         {
+            uint8_t expanded = node->expanded.load(std::memory_order_acquire);
+
+            // Nodes other than the root are only worth expanding once they
+            // have been visited a few times
+            if((expanded == UNEXPANDED) &&
+               ((depth == 1) || (node->visits.load(std::memory_order_relaxed) >= EXPAND_VISITS)))
+            {
+               expand(worker, state, *node);
+               expanded = node->expanded.load(std::memory_order_acquire);
+            }
+
+            if((expanded != EXPANDED) || (node->num_children == 0)) break;
+
+            unsigned mover = order[node->mover];
+
+            node = select(*node);
+
+            worker.path[depth++] = node;
+            node->visits.fetch_add(1, std::memory_order_relaxed);
+
+            play(state, node->move, mover);
+
+            if(state.arePegsHome(mover))
+            {
+               node->expanded.store(LEAF, std::memory_order_release);
+               win(worker, mover);
+               game_over = true;
+            }
+         }
+
+         if(!game_over) playout(worker, state);
+
+         // Add the result to every node on the way down
+         for(unsigned i = 0; i < depth; i++)
+         {
+            for(unsigned p = 0; p < num_players; p++)
+            {
+               worker.path[i]->value[p].fetch_add(worker.result[p], std::memory_order_relaxed);
+            }
+         }
+      }
+   }
+
+   //! Add a node for every move, if no other thread is already doing it
+   void expand(Worker& worker, const BoardState<N>& state, Node& node)
+   {
+      uint8_t expected = UNEXPANDED;
+
+      if(!node.expanded.compare_exchange_strong(expected, EXPANDING, std::memory_order_acquire))
+      {
+         return;
+      }
+
+      unsigned player = order[node.mover];
+
+      worker.move_gen.start(state, player, hop_mode);
+      worker.move_gen.generateOrdered();
+
+      unsigned num_children = worker.move_gen.size();
+      uint32_t first        = pool_used.fetch_add(num_children, std::memory_order_relaxed);
+
+      if((num_children > 0xFFFF) || ((first + num_children) > pool_size))
+      {
+         node.expanded.store(LEAF, std::memory_order_release);
+         return;
+      }
+
+      // Children in order of the greedy score so that the best is visited first
+      Move<N>  move;
+      unsigned score;
+      unsigned next_mover = (node.mover + 1) % num_players;
+
+      for(unsigned i = 0; worker.move_gen.next(move, score); i++)
+      {
+         resetNode(pool[first + i], move.pack(), next_mover);
+      }
+
+      node.first_child  = first;
+      node.num_children = num_children;
+      node.expanded.store(EXPANDED, std::memory_order_release);
+   }
+
+   //! Child with the best upper confidence bound for the player to move
+   Node* select(const Node& node)
+   {
+      static const double EXPLORE = 1.4;
+
+      unsigned p          = node.mover;
+      double   log_visits = std::log(double(node.visits.load(std::memory_order_relaxed)));
+      Node*    best       = &pool[node.first_child];
+      double   best_bound = -1.0;
+
+      for(unsigned i = 0; i < node.num_children; i++)
+      {
+         Node&    child  = pool[node.first_child + i];
+         uint32_t visits = child.visits.load(std::memory_order_relaxed);
+
+         // Unvisited moves first, best greedy score first
+         if(visits == 0) return &child;
+
+         double mean  = child.value[p].load(std::memory_order_relaxed) / double(VALUE_SCALE * visits);
+         double bound = mean + EXPLORE * std::sqrt(log_visits / visits);
+
+         if(bound > best_bound)
+         {
+            best_bound = bound;
+            best       = &child;
+         }
+      }
+
+      return best;
+   }
+
+   //! Play the rest of a game for a while with mostly greedy moves
+   void playout(Worker& worker, BoardState<N>& state)
+   {
+      unsigned max_moves = 4 * N * num_players;
+      unsigned mover     = index[state.getSideToMove()];
+
+      for(unsigned m = 0; m < max_moves; m++)
+      {
+         unsigned player = order[mover];
+
+         worker.move_gen.start(state, player, hop_mode);
+         worker.move_gen.generateOrdered();
+
+         if(worker.move_gen.size() != 0)
+         {
+            Move<N>  move;
+            unsigned score;
+
+            if((worker.random.next() % RANDOM_MOVE) == 0)
+            {
+               move = worker.move_gen[worker.random.next() % worker.move_gen.size()];
+            }
+            else
+            {
+               worker.move_gen.next(move, score);
+            }
+
+            play(state, move.pack(), player);
+
+            if(state.arePegsHome(player))
+            {
+               win(worker, player);
+               return;
+            }
+         }
+
+         mover = (mover + 1) % num_players;
+         state.setSideToMove(order[mover]);
+      }
+
+      // No winner yet, share out the result by how far each player has to go
+      unsigned dist[6];
+      unsigned max_dist = 0;
+      unsigned min_dist = ~0u;
+
+      for(unsigned p = 0; p < num_players; p++)
+      {
+         dist[p] = Evaluate<N>::distance(state, order[p]);
+
+         if(dist[p] > max_dist) max_dist = dist[p];
+         if(dist[p] < min_dist) min_dist = dist[p];
+      }
+
+      for(unsigned p = 0; p < num_players; p++)
+      {
+         worker.result[p] = max_dist == min_dist ? VALUE_SCALE / num_players
+                                                 : VALUE_SCALE * (max_dist - dist[p]) / (max_dist - min_dist);
+      }
+   }
+
+   void win(Worker& worker, unsigned player)
+   {
+      for(unsigned p = 0; p < num_players; p++)
+      {
+         worker.result[p] = order[p] == player ? VALUE_SCALE : 0;
+      }
+   }
+
+   //! Make a packed move and pass the turn on
+   void play(BoardState<N>& state, uint32_t packed, unsigned player)
+   {
+      state.makeMove(Move<N>::unpackStart(packed), Move<N>::unpackEnd(packed),
+                     order[(index[player] + 1) % num_players]);
+   }
+
+   HopMode                              hop_mode{HOP_PATHS};
+   unsigned                             num_players{0};
+   unsigned                             order[6]{};
+   unsigned                             index[7]{};
+   unsigned                             num_threads{1};
+   uint64_t                             seed{1};
+   unsigned                             pool_size{DEFAULT_POOL};
+   std::unique_ptr<Node[]>              pool;
+   std::atomic<uint32_t>                pool_used{0};
+   std::atomic<unsigned>                started{0};
+   std::atomic<bool>                    stopping{false};
+   unsigned                             budget{0};
+   bool                                 timed{false};
+   Clock::time_point                    deadline;
+   std::vector<std::unique_ptr<Worker>> workers;
+};
+
+#endif
@@ -24,57 +24,63 @@
 #define MOVE_H
 
 #include <cassert>
-#include <vector>
+#include <cstdint>
 
+#include "Hole.h"
 #include "Pos60.h"
 
+//! How chains of hops are generated
+enum HopMode : uint8_t
+{
+   HOP_PATHS,   //!< Every distinct path, a hole may be reached many times
+   HOP_CLOSURE  //!< Each reachable hole once, by a shortest path
+};
+
+
 //! Representation of a single move by a player
+//
+//  A move is 16 bytes and never allocates. The directions of a step or of
+//  each hop in a chain are packed 3 bits each into a 64-bit word. For a
+//  chain longer than MAX_PATH hops only the first MAX_PATH directions are
+//  kept (isLong() is true) and the rest must be recovered from the board
+//  when needed, as the end hole is always recorded.
+template <unsigned N>
 class Move
 {
 public:
-   Move(Pos60& start_)
+   static const unsigned MAX_PATH = 64 / 3;
+
+   Move() = default;
+
+   Move(Hole start_)
       : start(start_)
       , end(start_)
    {}
 
-   bool         empty()    const { return directions.empty(); }
-   bool         isStep()   const { return is_step; }
-   bool         isHop()    const { return !empty() && !isStep(); }
-   const Pos60& getStart() const { return start; }
-   const Pos60& getEnd()   const { return end; }
+   bool     empty()     const { return length == 0; }
+   bool     isStep()    const { return is_step; }
+   bool     isHop()     const { return !empty() && !isStep(); }
+   bool     isLong()    const { return length > MAX_PATH; }
+   Hole     getStart()  const { return start; }
+   Hole     getEnd()    const { return end; }
+   unsigned getLength() const { return length; }
 
-   const std::vector<Dir60>& getDirections() const { return directions; }
-
-   bool isAnotherHopOk(Dir60 next_dir) const
+   //! Direction of the i'th step or hop, i must be less than MAX_PATH
+   Dir60 getDirection(unsigned i) const
    {
-      assert(isHop());
-
-      Pos60 new_end = end;
-      new_end.move(next_dir, 2);
-
-      Pos60 pos = start;
-
-      if(new_end == pos) return false;
-
-      for(const auto& dir : directions)
-      {
-         pos.move(dir, 2);
-
-         if(new_end == pos) return false;
-      }
-
-      return true;
+      assert(i < MAX_PATH);
+      return Dir60(signed(path >> (i * 3)) & 0b111);
    }
 
    //! Make the move a single step
    void step(Dir60 dir)
    {
-      assert(directions.empty());
+      assert(empty());
 
       is_step = true;
-      directions.push_back(dir);
+      append(dir);
 
-      end.move(dir, 1);
+      end = HoleTable<N>::neighbour(end, dir);
    }
 
    //! Make a move a single hop or add an extra hop to a list hops
@@ -82,18 +88,91 @@ public:
    {
       assert(!is_step);
 
-      directions.push_back(dir);
+      append(dir);
+
+      end = HoleTable<N>::jump(end, dir);
+   }
+
+   //! Start and end of the move packed into 32 bits, never zero
+   uint32_t pack() const { return start | (uint32_t(end) << 16); }
+
+   static Hole unpackStart(uint32_t packed) { return Hole(packed & 0xFFFF); }
+   static Hole unpackEnd(uint32_t packed)   { return Hole(packed >> 16); }
 
-      end.move(dir, 2);
+   bool operator==(const Move& that) const
+   {
+      return (path    == that.path)  &&
+             (start   == that.start) &&
+             (end     == that.end)   &&
+             (length  == that.length) &&
+             (is_step == that.is_step);
    }
 
+   bool operator!=(const Move& that) const { return !operator==(that); }
+
 private:
-   Pos60              start;
-   bool               is_step{false};
-   std::vector<Dir60> directions;
-   Pos60              end;
+   void append(Dir60 dir)
+   {
+      if(length < MAX_PATH)
+      {
+         path |= uint64_t(dir.getIndex()) << (length * 3);
+      }
+
+      length++;
+   }
+
+   uint64_t path{0};
+   Hole     start{HoleTable<N>::NONE};
+   Hole     end{HoleTable<N>::NONE};
+   uint16_t length{0};
+   bool     is_step{false};
 };
 
-using MoveList = std::vector<Move>;
+
+//! Fixed capacity list of moves that never allocates
+//
+//  Moves added once the list is full are dropped and counted
+template <unsigned N, unsigned CAPACITY = HoleTable<N>::NUM_HOLES>
+class MoveList
+{
+public:
+   using iterator       = Move<N>*;
+   using const_iterator = const Move<N>*;
+
+   void clear()
+   {
+      num_moves = 0;
+      dropped   = 0;
+   }
+
+   bool     empty()      const { return num_moves == 0; }
+   unsigned size()       const { return num_moves; }
+   unsigned getDropped() const { return dropped; }
+
+   bool push_back(const Move<N>& move)
+   {
+      if(num_moves == CAPACITY)
+      {
+         dropped++;
+         return false;
+      }
+
+      moves[num_moves++] = move;
+      return true;
+   }
+
+         Move<N>& operator[](unsigned i)       { return moves[i]; }
+   const Move<N>& operator[](unsigned i) const { return moves[i]; }
+
+   iterator       begin()       { return moves; }
+   iterator       end()         { return moves + num_moves; }
+   const_iterator begin() const { return moves; }
+   const_iterator end()   const { return moves + num_moves; }
+
+private:
+   unsigned num_moves{0};
+   unsigned dropped{0};
+   Move<N>  moves[CAPACITY];
+};
 
 #endif
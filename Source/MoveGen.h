@@ -0,0 +1,764 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef MOVE_GEN_H
+#define MOVE_GEN_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "BoardState.h"
+#include "Evaluate.h"
+#include "Move.h"
+#include "Stats.h"
+#include "Trace.h"
+
+//! Move generation
+//
+//  The static members find the moves for a single peg and pass each one to
+//  a sink. An instance is a staged generator for all the pegs of a player
+//  that keeps every move in one arena allocated once and reused for each
+//  turn. Stages are generated only when needed, cheapest first (steps, then
+//  single hops, then chains of hops) and each stage is returned best first.
+//
+//  When all the moves are wanted at once they are kept for each player
+//  between turns. Only the pegs whose moves depend on a hole that has
+//  changed since that player's last turn have their moves found again.
+template <unsigned N>
+class MoveGen
+{
+public:
+   enum Stage : uint8_t
+   {
+      STAGE_STEPS,
+      STAGE_HOPS,
+      STAGE_CHAINS,
+      STAGE_DONE
+   };
+
+   //! Maximum moves in the arena, further moves are dropped
+   static const unsigned CAPACITY = 16 * HoleTable<N>::NUM_HOLES;
+
+   MoveGen()
+      : arena(new Arena)
+   {}
+
+   //! Check every set of moves kept between turns against finding all the
+   //  moves again, a difference is fatal
+   void setAudit(bool audit_) { audit = audit_; }
+
+   //! Find every move for a peg at a hole
+   //  With HOP_PATHS steps and hops are found in direction order, each hop
+   //  immediately followed by every chain that extends it
+   template <typename SINK>
+   static void findMoves(const BoardState<N>& state, Hole from, HopMode hop_mode, SINK sink)
+   {
+      Bitboard<N> on_path;
+      on_path.set(HoleTable<N>::getBit(from));
+
+      for(Dir60 dir; true; dir.rotRight())
+      {
+         Hole to = HoleTable<N>::neighbour(from, dir);
+
+         if(state.isEmpty(to))
+         {
+            // Can step
+            Move<N> move(from);
+
+            move.step(dir);
+
+            Stats::count(STAT_STEPS);
+            sink(move);
+         }
+         else if((hop_mode == HOP_PATHS) && state.isOccupied(to))
+         {
+            // Might be able to hop
+            to = HoleTable<N>::jump(from, dir);
+
+            if(state.isEmpty(to))
+            {
+               // Can hop
+               Move<N> move(from);
+
+               move.hop(dir);
+
+               Stats::count(STAT_HOPS);
+               sink(move);
+
+               tryAnotherHop(state, move, on_path, sink);
+            }
+         }
+
+         if(dir == 330) break;
+      }
+
+      if(hop_mode == HOP_CLOSURE)
+      {
+         findHopClosure(state, from, sink);
+      }
+   }
+
+   //! Find chains of two or more hops for a peg at a hole
+   //  The first hops are not counted in the stats, they are found as moves
+   //  of their own before the chains
+   template <typename SINK>
+   static void findChains(const BoardState<N>& state, Hole from, HopMode hop_mode, SINK sink)
+   {
+      if(hop_mode == HOP_CLOSURE)
+      {
+         findHopClosure(state, from, [&sink](const Move<N>& move)
+                                     {
+                                        if(move.getLength() > 1) sink(move);
+                                     },
+                                     /* count_first_hops */ false);
+         return;
+      }
+
+      Bitboard<N> on_path;
+      on_path.set(HoleTable<N>::getBit(from));
+
+      for(Dir60 dir; true; dir.rotRight())
+      {
+         if(state.isOccupied(HoleTable<N>::neighbour(from, dir)) &&
+            state.isEmpty(HoleTable<N>::jump(from, dir)))
+         {
+            Move<N> move(from);
+
+            move.hop(dir);
+
+            tryAnotherHop(state, move, on_path, sink);
+         }
+
+         if(dir == 330) break;
+      }
+   }
+
+   //! Recover a move for a player from its packed form
+   //  Returns false if the move is not possible in this position
+   static bool findMove(const BoardState<N>& state,
+                        unsigned             player,
+                        HopMode              hop_mode,
+                        uint32_t             packed,
+                        Move<N>&             move)
+   {
+      Hole start = Move<N>::unpackStart(packed);
+      Hole end   = Move<N>::unpackEnd(packed);
+
+      if((start >= HoleTable<N>::NUM_HOLES) || (state.getPeg(start) != player)) return false;
+
+      bool found = false;
+
+      findMoves(state, start, hop_mode,
+                [&](const Move<N>& candidate)
+                {
+                   if(!found && (candidate.getEnd() == end))
+                   {
+                      move  = candidate;
+                      found = true;
+                   }
+                });
+
+      return found;
+   }
+
+   //! Start generating the moves for a player
+   void start(const BoardState<N>& state_, unsigned player_, HopMode hop_mode_)
+   {
+      state      = &state_;
+      player     = player_;
+      hop_mode   = hop_mode_;
+      stage      = STAGE_STEPS;
+      next_index = 0;
+      promoted   = false;
+
+      arena->moves.clear();
+   }
+
+   //! Get the next move, best first within each stage
+   //  Returns false when there are no more moves
+   bool next(Move<N>& move, unsigned& score)
+   {
+      while(next_index == arena->moves.size())
+      {
+         if(stage == STAGE_DONE) return false;
+
+         generateStage();
+      }
+
+      if(promoted)
+      {
+         promoted = false;
+      }
+      else
+      {
+         // Bring the best of the rest of this stage forward
+         unsigned best = next_index;
+
+         for(unsigned i = next_index + 1; i < stage_end; i++)
+         {
+            if(arena->score[i] > arena->score[best]) best = i;
+         }
+
+         std::swap(arena->moves[next_index], arena->moves[best]);
+         std::swap(arena->score[next_index], arena->score[best]);
+      }
+
+      move  = arena->moves[next_index];
+      score = arena->score[next_index];
+      next_index++;
+      return true;
+   }
+
+   //! Generate all remaining stages at once, in no particular order
+   //  When nothing has been generated yet the moves kept from this player's
+   //  last turn are re-used where they are still valid
+   void generateAll()
+   {
+      Trace::Span span("MoveGen::generateAll");
+
+      if(stage == STAGE_STEPS)
+      {
+         generateIncremental();
+
+         if(audit) auditMoves();
+         return;
+      }
+
+      while(stage != STAGE_DONE)
+      {
+         generateStage();
+      }
+   }
+
+   //! Generate every stage now so that next() returns all the moves best first
+   void generateOrdered()
+   {
+      while(stage != STAGE_DONE)
+      {
+         generateStage();
+      }
+   }
+
+   //! Make a move, if it has been generated and not yet returned, the next
+   //  one returned by next()
+   bool promote(uint32_t packed)
+   {
+      for(unsigned i = next_index; i < arena->moves.size(); i++)
+      {
+         if(arena->moves[i].pack() == packed)
+         {
+            std::swap(arena->moves[next_index], arena->moves[i]);
+            std::swap(arena->score[next_index], arena->score[i]);
+            promoted = true;
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   //! Replace the score of each move not yet returned by next() with
+   //  fn(move, score), to change the order they are returned in
+   template <typename FN>
+   void rescore(FN fn)
+   {
+      for(unsigned i = next_index; i < arena->moves.size(); i++)
+      {
+         arena->score[i] = fn(arena->moves[i], arena->score[i]);
+      }
+   }
+
+   //! Moves generated so far
+   unsigned size() const { return arena->moves.size(); }
+
+   const Move<N>& operator[](unsigned i) const { return arena->moves[i]; }
+
+   unsigned getScore(unsigned i) const { return arena->score[i]; }
+
+   //! Moves lost because the arena was full
+   unsigned getDropped() const { return arena->moves.getDropped(); }
+
+   //! Number of times the moves for a peg were kept between turns
+   unsigned getReused() const { return reused; }
+
+   //! Number of times the moves for a peg had to be found again
+   unsigned getRegenerated() const { return regenerated; }
+
+private:
+   static const unsigned MAX_PEGS = N * (N + 1) / 2;
+
+   struct Arena
+   {
+      MoveList<N, CAPACITY> moves;
+      unsigned              score[CAPACITY];
+   };
+
+   //! The moves for one peg kept in a Cache
+   struct PegMoves
+   {
+      Hole        hole;
+      uint16_t    first;
+      uint16_t    count;
+      Bitboard<N> reach; //!< Holes the moves depend on
+   };
+
+   //! Moves kept for one player between turns
+   struct Cache
+   {
+      bool        valid{false};
+      HopMode     hop_mode{HOP_PATHS};
+      Bitboard<N> occupied;
+      unsigned    num_pegs{0};
+      PegMoves    peg[MAX_PEGS];
+      Arena       moves;
+   };
+
+   void add(const Move<N>& move)
+   {
+      unsigned i = arena->moves.size();
+
+      if(arena->moves.push_back(move))
+      {
+         arena->score[i] = Evaluate<N>::move(player, move);
+      }
+   }
+
+   //! Holes a peg at a hole can reach with a single hop
+   //  Two hops can land where a single hop does, so chains start out with
+   //  these holes already reached
+   static Bitboard<N> singleHopTargets(const BoardState<N>& state, Hole from)
+   {
+      Bitboard<N> targets;
+
+      for(Dir60 dir; true; dir.rotRight())
+      {
+         if(state.isOccupied(HoleTable<N>::neighbour(from, dir)) &&
+            state.isEmpty(HoleTable<N>::jump(from, dir)))
+         {
+            targets.set(HoleTable<N>::getBit(HoleTable<N>::jump(from, dir)));
+         }
+
+         if(dir == 330) break;
+      }
+
+      return targets;
+   }
+
+   //! Add the moves for a peg, finding each chain of hops to a hole once
+   void addPegMoves(Hole from, Bitboard<N>& reach)
+   {
+      Bitboard<N> reached = singleHopTargets(*state, from);
+
+      reach.clear();
+      addReach(reach, from);
+
+      findMoves(*state, from, hop_mode,
+                [&](const Move<N>& move)
+                {
+                   unsigned end_bit = HoleTable<N>::getBit(move.getEnd());
+
+                   if(move.getLength() > 1)
+                   {
+                      if(reached.test(end_bit)) return;
+
+                      reached.set(end_bit);
+                   }
+
+                   if(move.isHop())
+                   {
+                      addReach(reach, move.getEnd());
+                   }
+
+                   add(move);
+                });
+   }
+
+   //! Add the holes that are looked at when moving on from a hole
+   static void addReach(Bitboard<N>& reach, Hole at)
+   {
+      for(Dir60 dir; true; dir.rotRight())
+      {
+         Hole neighbour = HoleTable<N>::neighbour(at, dir);
+         Hole jump      = HoleTable<N>::jump(at, dir);
+
+         if(neighbour != HoleTable<N>::NONE) reach.set(HoleTable<N>::getBit(neighbour));
+         if(jump      != HoleTable<N>::NONE) reach.set(HoleTable<N>::getBit(jump));
+
+         if(dir == 330) break;
+      }
+   }
+
+   //! Generate all the moves re-using those kept from the player's last turn
+   //  The moves for a peg only depend on whether the holes in its reach are
+   //  occupied, so they are still valid if none of those holes has changed.
+   //  Comparing the whole board catches every change, including pegs that
+   //  passed through a hole during a chain of hops
+   void generateIncremental()
+   {
+      Trace::Span span("MoveGen::generateIncremental");
+
+      std::unique_ptr<Cache>& entry = cache[player];
+
+      if(!entry) entry.reset(new Cache);
+
+      Cache& kept = *entry;
+
+      bool        reuse   = kept.valid && (kept.hop_mode == hop_mode);
+      Bitboard<N> changed = state->getOccupied() ^ kept.occupied;
+
+      PegMoves peg[MAX_PEGS];
+      unsigned num_pegs = 0;
+      unsigned old      = 0;
+
+      // Pegs and kept moves are both in ascending bit order
+      const Bitboard<N>& pegs = state->getPegs(player);
+
+      pegs.forEach([&](unsigned bit)
+                   {
+                      while((old < kept.num_pegs) && (HoleTable<N>::getBit(kept.peg[old].hole) < bit))
+                      {
+                         old++;
+                      }
+
+                      PegMoves& next = peg[num_pegs++];
+
+                      next.hole  = HoleTable<N>::getHole(bit);
+                      next.first = arena->moves.size();
+
+                      if(reuse &&
+                         (old < kept.num_pegs) &&
+                         (kept.peg[old].hole == next.hole) &&
+                         (kept.peg[old].reach & changed).none())
+                      {
+                         const PegMoves& prev = kept.peg[old];
+
+                         for(unsigned i = prev.first; i < unsigned(prev.first + prev.count); i++)
+                         {
+                            unsigned index = arena->moves.size();
+
+                            if(arena->moves.push_back(kept.moves.moves[i]))
+                            {
+                               arena->score[index] = kept.moves.score[i];
+                            }
+                         }
+
+                         next.reach = prev.reach;
+                         reused++;
+                      }
+                      else
+                      {
+                         addPegMoves(next.hole, next.reach);
+                         regenerated++;
+                      }
+
+                      next.count = arena->moves.size() - next.first;
+                   });
+
+      // Keep these moves for the player's next turn
+      kept.valid    = true;
+      kept.hop_mode = hop_mode;
+      kept.occupied = state->getOccupied();
+      kept.num_pegs = num_pegs;
+
+      kept.moves.moves.clear();
+
+      for(unsigned i = 0; i < num_pegs; i++)
+      {
+         kept.peg[i] = peg[i];
+      }
+
+      for(unsigned i = 0; i < arena->moves.size(); i++)
+      {
+         kept.moves.moves.push_back(arena->moves[i]);
+         kept.moves.score[i] = arena->score[i];
+      }
+
+      stage     = STAGE_DONE;
+      stage_end = arena->moves.size();
+   }
+
+   //! Check the moves against generating every stage from scratch
+   void auditMoves()
+   {
+      if(!check) check.reset(new Arena);
+
+      std::swap(arena, check);
+
+      arena->moves.clear();
+      stage = STAGE_STEPS;
+
+      while(stage != STAGE_DONE)
+      {
+         generateStage();
+      }
+
+      std::swap(arena, check);
+
+      stage_end = arena->moves.size();
+
+      bool same = arena->moves.size() == check->moves.size();
+
+      for(unsigned i = 0; same && (i < arena->moves.size()); i++)
+      {
+         bool found = false;
+
+         for(unsigned j = 0; j < check->moves.size(); j++)
+         {
+            if(arena->moves[i] == check->moves[j])
+            {
+               found = arena->score[i] == check->score[j];
+               break;
+            }
+         }
+
+         same = found;
+      }
+
+      if(!same)
+      {
+         fprintf(stderr, "ERROR: player %u incremental moves differ from full generation\n", player);
+         abort();
+      }
+   }
+
+   void generateStage()
+   {
+      static const char* const name[] = {"MoveGen::steps", "MoveGen::hops", "MoveGen::chains", "MoveGen::done"};
+
+      Trace::Span span(name[stage]);
+
+      const Bitboard<N>& pegs = state->getPegs(player);
+
+      switch(stage)
+      {
+      case STAGE_STEPS:
+         for(Dir60 dir; true; dir.rotRight())
+         {
+            Dir60 back = dir;
+            back.rot180();
+
+            state->stepTargets(pegs, dir).forEach([&](unsigned bit)
+                                                 {
+                                                    Move<N> move(HoleTable<N>::neighbour(HoleTable<N>::getHole(bit), back));
+                                                    move.step(dir);
+                                                    Stats::count(STAT_STEPS);
+                                                    add(move);
+                                                 });
+
+            if(dir == 330) break;
+         }
+         stage = STAGE_HOPS;
+         break;
+
+      case STAGE_HOPS:
+         for(Dir60 dir; true; dir.rotRight())
+         {
+            Dir60 back = dir;
+            back.rot180();
+
+            state->hopTargets(pegs, dir).forEach([&](unsigned bit)
+                                                {
+                                                   Move<N> move(HoleTable<N>::jump(HoleTable<N>::getHole(bit), back));
+                                                   move.hop(dir);
+                                                   Stats::count(STAT_HOPS);
+                                                   add(move);
+                                                });
+
+            if(dir == 330) break;
+         }
+         stage = STAGE_CHAINS;
+         break;
+
+      case STAGE_CHAINS:
+         // Only the first chain found to each hole is kept, there can be
+         // very many different chains to the same hole
+         pegs.forEach([this](unsigned bit)
+                      {
+                         Hole        from    = HoleTable<N>::getHole(bit);
+                         Bitboard<N> reached = singleHopTargets(*state, from);
+
+                         findChains(*state, from, hop_mode,
+                                    [this, &reached](const Move<N>& move)
+                                    {
+                                       unsigned end_bit = HoleTable<N>::getBit(move.getEnd());
+
+                                       if(!reached.test(end_bit))
+                                       {
+                                          reached.set(end_bit);
+                                          add(move);
+                                       }
+                                    });
+                      });
+         stage = STAGE_DONE;
+         break;
+
+      case STAGE_DONE:
+         break;
+      }
+
+      stage_end = arena->moves.size();
+   }
+
+   //! Extend a chain of hops in every direction that does not land back on the chain
+   //  on_path holds the start and the landing holes of the chain so far
+   template <typename SINK>
+   static void tryAnotherHop(const BoardState<N>& state,
+                             const Move<N>&       move,
+                             Bitboard<N>&         on_path,
+                             SINK&                sink)
+   {
+      unsigned end_bit = HoleTable<N>::getBit(move.getEnd());
+
+      on_path.set(end_bit);
+
+      for(Dir60 dir; true; dir.rotRight())
+      {
+         Hole to = HoleTable<N>::jump(move.getEnd(), dir);
+
+         if(isAnotherHopOk(to, on_path))
+         {
+            if(state.isOccupied(HoleTable<N>::neighbour(move.getEnd(), dir)))
+            {
+               // Might be able to hop
+               if(state.isEmpty(to))
+               {
+                  // Can hop
+                  Move<N> another_move = move;
+
+                  another_move.hop(dir);
+
+                  Stats::count(STAT_EXTENSIONS);
+                  sink(another_move);
+
+                  tryAnotherHop(state, another_move, on_path, sink);
+               }
+            }
+         }
+         else
+         {
+            Stats::count(STAT_REJECTS);
+         }
+
+         if(dir == 330) break;
+      }
+
+      on_path.reset(end_bit);
+   }
+
+   //! Check that a hop does not land back on the chain of hops so far
+   static bool isAnotherHopOk(Hole to, const Bitboard<N>& on_path)
+   {
+      return (to == HoleTable<N>::NONE) || !on_path.test(HoleTable<N>::getBit(to));
+   }
+
+   //! Find one move for each hole reachable by a chain of hops
+   //  A breadth first search so each hole is reached by a shortest chain,
+   //  the hole each was first reached from is kept to rebuild the chain
+   template <typename SINK>
+   static void findHopClosure(const BoardState<N>& state, Hole start, SINK sink,
+                              bool count_first_hops = true)
+   {
+      Hole     queue[HoleTable<N>::NUM_HOLES];
+      Hole     from[HoleTable<N>::NUM_HOLES + 1];
+      uint8_t  from_dir[HoleTable<N>::NUM_HOLES + 1];
+      unsigned head = 0;
+      unsigned tail = 0;
+
+      Bitboard<N> visited;
+      visited.set(HoleTable<N>::getBit(start));
+
+      queue[tail++] = start;
+
+      while(head != tail)
+      {
+         Hole at = queue[head++];
+
+         for(Dir60 dir; true; dir.rotRight())
+         {
+            Hole to = HoleTable<N>::jump(at, dir);
+
+            if(state.isEmpty(to) &&
+               !visited.test(HoleTable<N>::getBit(to)) &&
+               state.isOccupied(HoleTable<N>::neighbour(at, dir)))
+            {
+               // Can hop to a new hole
+               visited.set(HoleTable<N>::getBit(to));
+
+               from[to]      = at;
+               from_dir[to]  = dir.getIndex();
+               queue[tail++] = to;
+
+               if(at != start)
+               {
+                  Stats::count(STAT_EXTENSIONS);
+               }
+               else if(count_first_hops)
+               {
+                  Stats::count(STAT_HOPS);
+               }
+
+               sink(rebuildChain(start, to, from, from_dir));
+            }
+
+            if(dir == 330) break;
+         }
+      }
+   }
+
+   //! Rebuild the chain of hops to a hole found by findHopClosure()
+   static Move<N> rebuildChain(Hole start, Hole to, const Hole* from, const uint8_t* from_dir)
+   {
+      Dir60    chain[HoleTable<N>::NUM_HOLES];
+      unsigned length = 0;
+
+      for(Hole h = to; h != start; h = from[h])
+      {
+         chain[length++] = Dir60(from_dir[h]);
+      }
+
+      Move<N> move(start);
+
+      while(length != 0)
+      {
+         move.hop(chain[--length]);
+      }
+
+      return move;
+   }
+
+   std::unique_ptr<Arena> arena;
+   std::unique_ptr<Arena> check;
+   std::unique_ptr<Cache> cache[7];
+   const BoardState<N>*   state{nullptr};
+   unsigned               player{0};
+   HopMode                hop_mode{HOP_PATHS};
+   Stage                  stage{STAGE_DONE};
+   unsigned               next_index{0};
+   unsigned               stage_end{0};
+   bool                   promoted{false};
+   bool                   audit{false};
+   unsigned               reused{0};
+   unsigned               regenerated{0};
+};
+
+#endif
@@ -0,0 +1,250 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "Hole.h"
+
+//! Efficiently updatable neural network evaluation for a size N board
+//
+//  There is one input for each player and hole, set when the player has a
+//  peg in the hole. The first layer sums the weights of the set inputs into
+//  an accumulator that is kept with the board and updated as each peg is
+//  placed or removed, so only the small second layer is computed for each
+//  evaluation. The second layer has one output for each player, the number
+//  of steps the player still needs to get home.
+//
+//  Weights file format, all little endian
+//     char    magic[4]                 "SNNU"
+//     uint32  version                  1
+//     uint32  size                     N
+//     uint32  hidden                   HIDDEN
+//     int16   bias[HIDDEN]
+//     int16   weight[6][NUM_HOLES][HIDDEN]   for players 1..6
+//     int32   out_bias[6]
+//     int8    out_weight[6][HIDDEN]
+//
+//  An output is (out_bias + sum out_weight * clamp(accumulator, 0, 127))
+//  divided by OUT_SCALE.
+template <unsigned N>
+class Nnue
+{
+public:
+   static const unsigned HIDDEN    = 64;
+   static const unsigned OUT_SCALE = 64;
+
+   //! First layer sums for a board
+   struct Accumulator
+   {
+      alignas(32) int16_t value[HIDDEN];
+   };
+
+   //! Load the weights from a file, returns false if the file can't be read
+   //  or is not for this board size
+   static bool load(const char* filename)
+   {
+      FILE* fp = fopen(filename, "rb");
+      if(fp == nullptr) return false;
+
+      std::unique_ptr<Weights> w(new Weights());
+
+      char     magic[4];
+      uint32_t header[3];
+
+      bool ok = (fread(magic, sizeof(magic), 1, fp) == 1) &&
+                (memcmp(magic, "SNNU", 4) == 0) &&
+                (fread(header, sizeof(header), 1, fp) == 1) &&
+                (header[0] == 1) && (header[1] == N) && (header[2] == HIDDEN) &&
+                (fread(w->bias, sizeof(w->bias), 1, fp) == 1);
+
+      // The tables in memory have an extra row for HoleTable::NONE
+      for(unsigned player = 1; ok && (player <= 6); player++)
+      {
+         ok = fread(w->weight[player], sizeof(int16_t) * HIDDEN, NUM_HOLES, fp) == NUM_HOLES;
+      }
+
+      ok = ok && (fread(w->out_bias + 1, sizeof(int32_t), 6, fp) == 6);
+
+      for(unsigned player = 1; ok && (player <= 6); player++)
+      {
+         int8_t out_weight[HIDDEN];
+
+         ok = fread(out_weight, sizeof(out_weight), 1, fp) == 1;
+
+         for(unsigned i = 0; i < HIDDEN; i++)
+         {
+            w->out_weight[player][i] = out_weight[i];
+         }
+      }
+
+      fclose(fp);
+
+      if(ok) weights = std::move(w);
+
+      return ok;
+   }
+
+   //! Weights have been loaded and should be used for evaluation
+   static bool isLoaded() { return weights != nullptr; }
+
+   //! Set an accumulator for an empty board
+   static void reset(Accumulator& acc)
+   {
+      for(unsigned i = 0; i < HIDDEN; i++)
+      {
+         acc.value[i] = weights ? weights->bias[i] : 0;
+      }
+   }
+
+   //! Update an accumulator for a peg placed in a hole
+   static void add(Accumulator& acc, Hole hole, unsigned player)
+   {
+      update<+1>(acc, weights->weight[player][hole]);
+   }
+
+   //! Update an accumulator for a peg removed from a hole
+   static void sub(Accumulator& acc, Hole hole, unsigned player)
+   {
+      update<-1>(acc, weights->weight[player][hole]);
+   }
+
+   //! Steps a player still needs to get home
+   static unsigned evaluate(const Accumulator& acc, unsigned player)
+   {
+      signed sum = weights->out_bias[player] + dot(acc.value, weights->out_weight[player]);
+
+      return sum > 0 ? sum / OUT_SCALE : 0;
+   }
+
+private:
+   static const unsigned NUM_HOLES = HoleTable<N>::NUM_HOLES;
+
+   struct Weights
+   {
+      alignas(32) int16_t bias[HIDDEN];
+      alignas(32) int16_t weight[7][NUM_HOLES + 1][HIDDEN];
+      alignas(32) int16_t out_weight[7][HIDDEN];  //!< Widened from int8 when loaded
+      int32_t             out_bias[7];
+   };
+
+   template <signed SIGN>
+   static void update(Accumulator& acc, const int16_t* column)
+   {
+#if defined(__AVX2__)
+      for(unsigned i = 0; i < HIDDEN; i += 16)
+      {
+         __m256i a = _mm256_load_si256((const __m256i*)&acc.value[i]);
+         __m256i c = _mm256_load_si256((const __m256i*)&column[i]);
+
+         a = SIGN > 0 ? _mm256_add_epi16(a, c) : _mm256_sub_epi16(a, c);
+
+         _mm256_store_si256((__m256i*)&acc.value[i], a);
+      }
+#elif defined(__SSE2__)
+      for(unsigned i = 0; i < HIDDEN; i += 8)
+      {
+         __m128i a = _mm_load_si128((const __m128i*)&acc.value[i]);
+         __m128i c = _mm_load_si128((const __m128i*)&column[i]);
+
+         a = SIGN > 0 ? _mm_add_epi16(a, c) : _mm_sub_epi16(a, c);
+
+         _mm_store_si128((__m128i*)&acc.value[i], a);
+      }
+#else
+      for(unsigned i = 0; i < HIDDEN; i++)
+      {
+         acc.value[i] = int16_t(acc.value[i] + SIGN * column[i]);
+      }
+#endif
+   }
+
+   //! Sum of the clamped accumulator times the output weights
+   //  The int8 output weights were widened to int16 when loaded, so that
+   //  madd can multiply them with the int16 accumulator into int32 sums
+   static signed dot(const int16_t* acc, const int16_t* out_weight)
+   {
+#if defined(__AVX2__)
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i max  = _mm256_set1_epi16(127);
+      __m256i       sum  = _mm256_setzero_si256();
+
+      for(unsigned i = 0; i < HIDDEN; i += 16)
+      {
+         __m256i a = _mm256_load_si256((const __m256i*)&acc[i]);
+         __m256i w = _mm256_load_si256((const __m256i*)&out_weight[i]);
+
+         a   = _mm256_min_epi16(_mm256_max_epi16(a, zero), max);
+         sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+      }
+
+      __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+      half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+      half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+      return _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i max  = _mm_set1_epi16(127);
+      __m128i       sum  = _mm_setzero_si128();
+
+      for(unsigned i = 0; i < HIDDEN; i += 8)
+      {
+         __m128i a = _mm_load_si128((const __m128i*)&acc[i]);
+         __m128i w = _mm_load_si128((const __m128i*)&out_weight[i]);
+
+         a   = _mm_min_epi16(_mm_max_epi16(a, zero), max);
+         sum = _mm_add_epi32(sum, _mm_madd_epi16(a, w));
+      }
+
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+      return _mm_cvtsi128_si32(sum);
+#else
+      signed sum = 0;
+
+      for(unsigned i = 0; i < HIDDEN; i++)
+      {
+         signed a = acc[i] < 0 ? 0 : acc[i] > 127 ? 127 : acc[i];
+
+         sum += a * out_weight[i];
+      }
+
+      return sum;
+#endif
+   }
+
+   static std::unique_ptr<Weights> weights;
+};
+
+template <unsigned N>
+std::unique_ptr<typename Nnue<N>::Weights> Nnue<N>::weights;
+
+#endif
@@ -23,36 +23,35 @@
 #ifndef PEG_H
 #define PEG_H
 
-#include "Board.h"
+#include "BoardState.h"
 #include "Move.h"
+#include "Trace.h"
 
 template <unsigned N> class Peg
 {
 public:
-   const Pos60& getPos() const { return pos; }
-         Pos60& getPos()       { return pos; }
+   Hole getHole() const { return hole; }
 
-   bool isHome() const { return board->isPegHome(pos); }
+   bool isHome() const { return state->isPegHome(hole); }
 
    //! Initialise a peg and place it in it's starting position
-   void initialise(Board<N>&    board_,
-                   uint8_t      id_,
-                   const Pos60& target_,
-                   const Pos60& start_pos_)
+   void initialise(BoardState<N>& state_,
+                   uint8_t        id_,
+                   Hole           start_hole_)
    {
-      board  = &board_;
-      id     = id_;
-      target = target_;
+      state = &state_;
+      id    = id_;
+      hole  = HoleTable<N>::NONE;
 
-      move(start_pos_);
+      move(start_hole_);
    }
 
    //! Perform a step if possible
    bool tryStep(Dir60 dir)
    {
-      Pos60 to(pos, dir, 1);
+      Hole to = HoleTable<N>::neighbour(hole, dir);
 
-      if(!board->isEmpty(to)) return false;
+      if(!state->isEmpty(to)) return false;
 
       move(to);
       return true;
@@ -61,189 +60,132 @@ public:
    //! Perform a hop if possible
    bool tryHop(Dir60 dir)
    {
-      Pos60 to(pos, dir, 1);
+      if(!state->isOccupied(HoleTable<N>::neighbour(hole, dir))) return false;
 
-      if(!board->isOccupied(to)) return false;
+      Hole to = HoleTable<N>::jump(hole, dir);
 
-      to.move(dir, 1);
-
-      if(!board->isEmpty(to)) return false;
+      if(!state->isEmpty(to)) return false;
 
       move(to);
       return true;
    }
 
-   //! Build the list of possible moves for this peg
-   unsigned findMoves(bool keep_all_moves)
+   //! Choose the move that doBestMove() will perform
+   void setBestMove(const Move<N>& move)
    {
-      move_list.clear();
-
-      best_move_score = 0;
-      best_move       = nullptr;
-
-      for(Dir60 dir; true; dir.rotRight())
-      {
-         Pos60 to(pos, dir, 1);
-
-         if(board->isEmpty(to))
-         {
-            // Can step
-            Move move(pos);
-
-            move.step(dir);
-
-            addMove(move, keep_all_moves);
-         }
-         else if(board->isOccupied(to))
-         {
-            // Might be able to hop
-            to.move(dir, 1);
-
-            if(board->isEmpty(to))
-            {
-               // Can hop
-               Move move(pos);
-
-               move.hop(dir);
-
-               addMove(move, keep_all_moves);
-
-               tryAnotherHop(move, keep_all_moves);
-            }
-         }
-
-         if(dir == 330) break;
-      }
-
-      return best_move_score;
+      best_move = move;
    }
 
    //! Do the best move
    //  Returns true when the move is complete
    bool doBestMove(bool start_move)
    {
+      Trace::Span span("Peg::doBestMove");
+
       if(start_move)
       {
-         board->showAction(pos, ACT_PICK);
+         state->showAction(hole, ACT_PICK);
 
-         move_it = best_move->getDirections().begin();
+         move_index = 0;
          return false;
       }
 
-      board->showAction(pos, ACT_NONE);
+      state->showAction(hole, ACT_NONE);
 
-      if(pos == best_move->getEnd())
+      if(hole == best_move.getEnd())
       {
          return true;
       }
 
-      Pos60 next_pos = pos;
-      Dir60 dir      = *move_it;
-      next_pos.move(dir, best_move->isStep() ? 1 : 2);
-      move(next_pos);
+      Dir60 dir;
+
+      if(move_index < Move<N>::MAX_PATH)
+      {
+         dir = best_move.getDirection(move_index);
+      }
+      else if(!findHopDirection(best_move.getEnd(), dir))
+      {
+         // Tail of a long move is no longer possible, just finish it
+         move(best_move.getEnd());
+         state->showAction(hole, ACT_DROP);
+         return false;
+      }
+
+      move(best_move.isStep() ? HoleTable<N>::neighbour(hole, dir)
+                              : HoleTable<N>::jump(hole, dir));
 
-      if(pos == best_move->getEnd())
+      if(hole == best_move.getEnd())
       {
-         board->showAction(pos, ACT_DROP);
+         state->showAction(hole, ACT_DROP);
       }
       else
       {
-         move_it++;
-         board->showAction(pos, ACT_HOP);
+         move_index++;
+         state->showAction(hole, ACT_HOP);
       }
       return false;
    }
 
 private:
-   void move(const Pos60& pos_)
+   void move(Hole hole_)
    {
-      if(board->isOccupied(pos))
+      if(state->isOccupied(hole))
       {
-         board->setEmpty(pos);
+         state->setEmpty(hole);
       }
-      pos = pos_;
-      board->setPeg(pos, id);
-      board->refresh();
+      hole = hole_;
+      state->setPeg(hole, id);
    }
 
-   void tryAnotherHop(const Move& move, bool keep_all_moves)
+   //! Find the direction of the first hop in a chain of hops from this peg to a hole
+   //  Used to recover the part of a long move that is not recorded in the Move
+   bool findHopDirection(Hole to, Dir60& first_dir) const
    {
-      for(Dir60 dir; true; dir.rotRight())
+      static const uint8_t UNVISITED = 0xFF;
+
+      Hole    queue[HoleTable<N>::NUM_HOLES];
+      uint8_t first[HoleTable<N>::NUM_HOLES + 1];
+      unsigned head = 0;
+      unsigned tail = 0;
+
+      for(auto& f : first) f = UNVISITED;
+
+      queue[tail++] = hole;
+
+      while(head != tail)
       {
-         if(move.isAnotherHopOk(dir))
+         Hole from = queue[head++];
+
+         for(Dir60 dir; true; dir.rotRight())
          {
-            Pos60 to(move.getEnd(), dir, 1);
+            Hole next = HoleTable<N>::jump(from, dir);
 
-            if(board->isOccupied(to))
+            if((first[next] == UNVISITED) &&
+               state->isOccupied(HoleTable<N>::neighbour(from, dir)) &&
+               state->isEmpty(next))
             {
-               // Might be able to hop
-               to.move(dir, 1);
+               first[next]   = from == hole ? dir.getIndex() : first[from];
+               queue[tail++] = next;
 
-               if(board->isEmpty(to))
+               if(next == to)
                {
-                  // Can hop
-                  Move another_move = move;
-
-                  another_move.hop(dir);
-
-                  addMove(another_move, keep_all_moves);
-
-                  tryAnotherHop(another_move, keep_all_moves);
+                  first_dir = Dir60(first[next]);
+                  return true;
                }
             }
-         }
-
-         if(dir == 330) break;
-      }
-   }
-
-   void addMove(const Move& move, bool keep_all_moves)
-   {
-      unsigned score   = evaluate(move);
-      bool     is_best = score > best_move_score;
-
-      if(keep_all_moves || is_best)
-      {
-         if(!keep_all_moves)
-         {
-            move_list.clear();
-         }
-
-         move_list.push_back(move);
 
-         if(is_best)
-         {
-            best_move_score = score;
-            best_move       = &move_list.back();
+            if(dir == 330) break;
          }
       }
-   }
-
-   static unsigned distSquared(const Pos60& from, const Pos60& to)
-   {
-      signed delta_x = to.getX() - from.getX();
-      signed delta_y = to.getY() - from.getY();
-
-      return delta_x * delta_x + delta_y * delta_y * 3;
-   }
 
-   unsigned evaluate(const Move& move)
-   {
-      unsigned dist_before = distSquared(target, move.getStart());
-      unsigned dist_after  = distSquared(target, move.getEnd());
-
-      return 1000000 + dist_before - dist_after;
+      return false;
    }
 
-   Board<N>* board{nullptr};
-   uint8_t   id{0};
-   Pos60     target;
-   Pos60     pos;
-   MoveList  move_list;
-   unsigned  best_move_score{0};
-   Move*     best_move{nullptr};
-
-   std::vector<Dir60>::const_iterator move_it;
+   BoardState<N>* state{nullptr};
+   uint8_t        id{0};
+   Hole           hole{HoleTable<N>::NONE};
+   Move<N>        best_move;
+   unsigned       move_index{0};
 };
 
 #endif
@@ -0,0 +1,317 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BoardState.h"
+#include "Move.h"
+#include "MoveGen.h"
+
+//! Count the positions reached by every sequence of moves to a depth
+//
+//  For checking move generation against a known count and for measuring
+//  its speed. Moves are either every move found by MoveGen::findMoves()
+//  for each peg, so a hole reached by two chains of hops counts twice,
+//  or with dedup one move per peg to each hole, as seen by the search.
+//  A move that brings all of a player's pegs home ends the game and so
+//  counts as one position whatever the depth left.
+//
+//  The moves from the starting position are shared out between threads.
+//  Counts for the positions below can be kept in a hash table shared by
+//  the threads without any locks, in the same way as TransTable.
+template <unsigned N>
+class Perft
+{
+public:
+   static const unsigned MAX_DEPTH = 16;
+
+   //! Put each player's pegs in the home triangle opposite their own
+   static void setup(BoardState<N>& state, const unsigned* player, unsigned num_players)
+   {
+      state.clear();
+
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         unsigned opposite = (player[i] + 2) % 6 + 1;
+
+         state.getHomeHoles(opposite).forEach([&state, &player, i](unsigned bit)
+                                              {
+                                                 state.setPeg(HoleTable<N>::getHole(bit), player[i]);
+                                              });
+      }
+
+      state.setSideToMove(player[0]);
+   }
+
+   //! Set the players in the order they take turns
+   void setPlayers(const unsigned* player, unsigned num_players)
+   {
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         next_player[player[i]] = player[(i + 1) % num_players];
+      }
+   }
+
+   void setHopMode(HopMode hop_mode_) { hop_mode = hop_mode_; }
+
+   //! Only one move for each peg to each hole
+   void setDedup(bool dedup_) { dedup = dedup_; }
+
+   void setThreads(unsigned num_threads_) { num_threads = num_threads_ == 0 ? 1 : num_threads_; }
+
+   //! Size of the hash table for counts in Mbytes, zero for none
+   void setHashSize(unsigned mbytes)
+   {
+      num_entries = 0;
+      hash.reset();
+
+      if(mbytes == 0) return;
+
+      num_entries = 1;
+
+      while((num_entries * 2 * sizeof(Entry)) <= (size_t(mbytes) << 20))
+      {
+         num_entries *= 2;
+      }
+
+      hash.reset(new Entry[num_entries]);
+   }
+
+   //! Count the positions depth moves on from a position
+   uint64_t run(const BoardState<N>& state, unsigned depth)
+   {
+      for(size_t i = 0; i < num_entries; i++)
+      {
+         hash[i].key_xor_count.store(0, std::memory_order_relaxed);
+         hash[i].count.store(0, std::memory_order_relaxed);
+      }
+
+      root_moves.clear();
+      root_count.clear();
+      dropped.store(0, std::memory_order_relaxed);
+
+      if((depth == 0) || (depth > MAX_DEPTH)) return depth == 0 ? 1 : 0;
+
+      // Moves from the starting position
+      {
+         Worker worker;
+
+         unsigned n = generate(worker, state, 0);
+
+         for(unsigned i = 0; i < n; i++)
+         {
+            root_moves.push_back(worker.moves(0, i).pack());
+         }
+      }
+
+      root_count.assign(root_moves.size(), 0);
+
+      std::atomic<unsigned> next_root{0};
+
+      auto split = [this, &state, &next_root, depth]()
+                   {
+                      std::unique_ptr<Worker> worker(new Worker);
+
+                      worker->state = state;
+
+                      for(unsigned i; (i = next_root++) < root_moves.size(); )
+                      {
+                         root_count[i] = child(*worker, root_moves[i], 1, depth - 1);
+                      }
+                   };
+
+      std::vector<std::thread> threads;
+
+      for(unsigned i = 1; i < num_threads; i++)
+      {
+         threads.emplace_back(split);
+      }
+
+      split();
+
+      for(auto& thread : threads)
+      {
+         thread.join();
+      }
+
+      uint64_t total = 0;
+
+      for(uint64_t count : root_count)
+      {
+         total += count;
+      }
+
+      return total;
+   }
+
+   //! Moves from the starting position of the last run and the count below each
+   unsigned getRootMoves() const { return root_moves.size(); }
+
+   uint32_t getRootMove(unsigned i) const { return root_moves[i]; }
+
+   uint64_t getRootCount(unsigned i) const { return root_count[i]; }
+
+   //! Number of times moves were lost because there were too many to keep,
+   //  the count is wrong if this is not zero
+   uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+   //! Count entry, the key is XORed with the count so that a torn entry misses
+   struct Entry
+   {
+      std::atomic<uint64_t> key_xor_count{0};
+      std::atomic<uint64_t> count{0};
+   };
+
+   //! Boards and moves for one thread
+   struct Worker
+   {
+      Worker()
+         : gen(new MoveGen<N>[MAX_DEPTH])
+         , list(new MoveList<N, MoveGen<N>::CAPACITY>[MAX_DEPTH])
+      {}
+
+      //! A move generated at a ply by generate()
+      const Move<N>& moves(unsigned ply, unsigned i) const
+      {
+         return dedup_ply[ply] ? gen[ply][i] : list[ply][i];
+      }
+
+      BoardState<N>                                         state;
+      std::unique_ptr<MoveGen<N>[]>                         gen;
+      std::unique_ptr<MoveList<N, MoveGen<N>::CAPACITY>[]>  list;
+      bool                                                  dedup_ply[MAX_DEPTH]{};
+   };
+
+   //! Find the moves for the player to move, returns the number found
+   unsigned generate(Worker& worker, const BoardState<N>& state, unsigned ply)
+   {
+      unsigned player = state.getSideToMove();
+
+      worker.dedup_ply[ply] = dedup;
+
+      if(dedup)
+      {
+         MoveGen<N>& gen = worker.gen[ply];
+
+         gen.start(state, player, hop_mode);
+         gen.generateOrdered();
+
+         if(gen.getDropped() != 0) dropped++;
+
+         return gen.size();
+      }
+
+      auto& list = worker.list[ply];
+
+      list.clear();
+
+      state.getPegs(player).forEach([&](unsigned bit)
+                                    {
+                                       MoveGen<N>::findMoves(state, HoleTable<N>::getHole(bit), hop_mode,
+                                                             [&list](const Move<N>& move) { list.push_back(move); });
+                                    });
+
+      if(list.getDropped() != 0) dropped++;
+
+      return list.size();
+   }
+
+   //! Count the positions depth_left moves on from the position after a move
+   uint64_t child(Worker& worker, uint32_t packed, unsigned ply, unsigned depth_left)
+   {
+      BoardState<N>& state  = worker.state;
+      unsigned       player = state.getSideToMove();
+
+      typename BoardState<N>::Undo undo = state.makeMove(Move<N>::unpackStart(packed),
+                                                         Move<N>::unpackEnd(packed),
+                                                         next_player[player]);
+
+      uint64_t total = state.arePegsHome(player) ? 1 : countBelow(worker, ply, depth_left);
+
+      state.unmakeMove(undo);
+
+      return total;
+   }
+
+   //! Count the positions depth_left moves on from the worker's board
+   uint64_t countBelow(Worker& worker, unsigned ply, unsigned depth_left)
+   {
+      if(depth_left == 0) return 1;
+
+      // The same position counts differently at each depth
+      uint64_t key = worker.state.getKey() + depth_left * 0x9E3779B97F4A7C15ull;
+
+      if(num_entries != 0)
+      {
+         Entry&   entry = hash[key & (num_entries - 1)];
+         uint64_t count = entry.count.load(std::memory_order_relaxed);
+
+         if((entry.key_xor_count.load(std::memory_order_relaxed) ^ count) == key) return count;
+      }
+
+      unsigned n     = generate(worker, worker.state, ply);
+      uint64_t total = 0;
+
+      if(depth_left == 1)
+      {
+         // Each move leads to one position, no need to make them
+         total = n;
+      }
+      else
+      {
+         for(unsigned i = 0; i < n; i++)
+         {
+            total += child(worker, worker.moves(ply, i).pack(), ply + 1, depth_left - 1);
+         }
+      }
+
+      if(num_entries != 0)
+      {
+         Entry& entry = hash[key & (num_entries - 1)];
+
+         entry.key_xor_count.store(key ^ total, std::memory_order_relaxed);
+         entry.count.store(total, std::memory_order_relaxed);
+      }
+
+      return total;
+   }
+
+   HopMode                  hop_mode{HOP_PATHS};
+   bool                     dedup{true};
+   unsigned                 num_threads{1};
+   unsigned                 next_player[7]{};
+   std::unique_ptr<Entry[]> hash;
+   size_t                   num_entries{0};
+   std::vector<uint32_t>    root_moves;
+   std::vector<uint64_t>    root_count;
+   std::atomic<uint64_t>    dropped{0};
+};
+
+#endif
@@ -23,37 +23,59 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 
 #include "PLT/KeyCode.h"
 
-#include "Board.h"
+#include "BoardState.h"
+#include "Mcts.h"
+#include "MoveGen.h"
 #include "Peg.h"
+#include "Random.h"
+#include "Search.h"
+#include "Stats.h"
+#include "Thinker.h"
+#include "TimeManager.h"
+#include "Trace.h"
+#include "TransTable.h"
 
 template <unsigned N>
 class Player
 {
 public:
    //! Put a players pieces into their initial positions
-   void initialise(Board<N>& board_, unsigned id_, bool human_)
+   //  Computer moves are generated with a move generator and transposition
+   //  table shared by all players
+   void initialise(BoardState<N>& state_,
+                   MoveGen<N>&    move_gen_,
+                   TransTable&    trans_table_,
+                   unsigned       id_,
+                   bool           human_)
    {
-      // Allow re-initialisation
-      new(this) Player();
-
-      board = &board_;
-      human = human_;
+      state            = &state_;
+      move_gen         = &move_gen_;
+      trans_table      = &trans_table_;
+      search           = nullptr;
+      limits           = typename Search<N>::Limits();
+      mcts             = nullptr;
+      playouts         = 0;
+      random_moves     = 0;
+      thinker          = nullptr;
+      time_manager     = nullptr;
+      thinking         = false;
+      num_pondered     = 0;
+      id               = id_;
+      human            = human_;
+      hop_mode         = HOP_PATHS;
+      move_state       = START;
+      peg_index        = 0;
+      best_peg_to_move = nullptr;
 
       // Compute a direction orthogonal to the way home
-      across.rotRight(id_ + 3);
-
-      // Find the home position
-      Pos60 home;
-
-      Dir60 back(id_ + 2);
-      home.move(back, N);
-
-      back.rotLeft();
-      home.move(back, N);
+      across = Dir60(id_ + 3);
 
       // Find one end of the front starting row
       Pos60 row;
@@ -72,7 +94,7 @@ public:
 
          for(unsigned k = 0; k < j; k++)
          {
-            peg_list[i++].initialise(board_, id_, home, pos);
+            peg_list[i++].initialise(state_, id_, HoleTable<N>::getHole(pos));
 
             pos.move(across);
          }
@@ -88,16 +110,68 @@ public:
                    : computerTurn(start_turn);
    }
 
-   bool areAllPegsHome() const
+   unsigned getId() const { return id; }
+
+   bool isHuman() const { return human; }
+
+   //! Select how chains of hops are found for computer moves
+   void setHopMode(HopMode hop_mode_) { hop_mode = hop_mode_; }
+
+   //! Select Monte Carlo tree search with a number of playouts for computer moves
+   //  This takes priority over any search set by setSearch()
+   void setMcts(Mcts<N>* mcts_, unsigned playouts_)
+   {
+      mcts     = mcts_;
+      playouts = playouts_;
+   }
+
+   //! Make the next few computer moves at random, so that games differ but
+   //  can be repeated from the seed
+   void setRandomMoves(unsigned random_moves_, uint64_t seed)
    {
-      bool home = true;
+      random_moves = random_moves_;
+      random.seed(seed);
+   }
 
-      for(auto& peg : peg_list)
-      {
-         if(!peg.isHome()) return false;
-      }
+   //! Select a search for computer moves, without one moves are chosen greedily
+   void setSearch(Search<N>* search_, const typename Search<N>::Limits& limits_)
+   {
+      search = search_;
+      limits = limits_;
+   }
+
+   //! Limit the time for computer moves that search, and charge the time
+   //  taken to this player's clock
+   void setTimeManager(TimeManager* time_manager_) { time_manager = time_manager_; }
+
+   //! Choose computer moves with a thinker so that the display and the
+   //  keyboard carry on while they are found. The turn is not started until
+   //  the move has been chosen, while isThinking() is true
+   void setThinker(Thinker* thinker_) { thinker = thinker_; }
 
-      return home;
+   bool isThinking() const { return thinking; }
+
+   //! Use the thinker while another player takes a turn, to choose this
+   //  player's reply to each of the likely moves of the player to move.
+   //  If the move made is one of them the reply is ready at once, otherwise
+   //  the transposition table still has what was found so far
+   void ponder(const BoardState<N>& position)
+   {
+      if((thinker == nullptr) || human || (random_moves != 0)) return;
+
+      thinker->cancel();
+
+      ponder_state = position;
+      num_pondered = 0;
+
+      stopping.store(false, std::memory_order_relaxed);
+
+      thinker->run([this]() { ponderMoves(); }, [this]() { stopChoosing(); });
+   }
+
+   bool areAllPegsHome() const
+   {
+      return state->arePegsHome(id);
    }
 
 private:
@@ -117,14 +191,13 @@ private:
          move_state  = START;
          peg_index   = 0;
          Peg<N>& peg = peg_list[peg_index];
-         board->showAction(peg.getPos(), ACT_PICK);
-         board->setWait(true);
+         state->showAction(peg.getHole(), ACT_PICK);
          return false;
       }
 
       Peg<N>* peg = &peg_list[peg_index];
 
-      board->showAction(peg->getPos(), ACT_NONE);
+      state->showAction(peg->getHole(), ACT_NONE);
 
       Dir60 dir;
 
@@ -143,7 +216,6 @@ private:
       case PLT::RETURN:
          if((move_state == STEP) || (move_state == HOP))
          {
-            board->setWait(false);
             return true;
          }
          break;
@@ -176,9 +248,9 @@ private:
 
       switch(move_state)
       {
-      case START: board->showAction(peg->getPos(), ACT_PICK); break;
-      case STEP:  board->showAction(peg->getPos(), ACT_DROP); break;
-      case HOP:   board->showAction(peg->getPos(), ACT_HOP);  break;
+      case START: state->showAction(peg->getHole(), ACT_PICK); break;
+      case STEP:  state->showAction(peg->getHole(), ACT_DROP); break;
+      case HOP:   state->showAction(peg->getHole(), ACT_HOP);  break;
       default: break;
       }
 
@@ -187,27 +259,264 @@ private:
 
    bool computerTurn(bool start_turn)
    {
+      Trace::Span span("Player::computerTurn");
+
       if(start_turn)
       {
-         best_peg_to_move = nullptr;
+         if(thinker == nullptr)
+         {
+            think(*state);
+            return startMove();
+         }
+
+         // Whatever was being pondered is no longer needed
+         thinker->cancel();
+
+         if(findPondered()) return startMove();
+
+         // The display carries on with the board while the thinker has a copy
+         think_state = *state;
+         thinking    = true;
+
+         stopping.store(false, std::memory_order_relaxed);
+
+         thinker->run([this]() { think(think_state); }, [this]() { stopChoosing(); });
+         return false;
+      }
+
+      if(thinking)
+      {
+         if(thinker->isBusy()) return false;
+
+         thinking = false;
+         return startMove();
+      }
+
+      return best_peg_to_move->doBestMove(false);
+   }
+
+   //! Choose the move for this player's turn
+   void think(const BoardState<N>& position)
+   {
+      Trace::Span span("Player::think");
+
+      auto start = std::chrono::steady_clock::now();
+
+      think_found = chooseMove(position, think_move);
+
+      auto end = std::chrono::steady_clock::now();
+
+      if(time_manager != nullptr)
+      {
+         time_manager->charge(id, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+      }
+
+      if(Stats::ENABLED)
+      {
+         Stats::count(STAT_TURNS);
+         Stats::count(STAT_THINK_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+      }
+   }
+
+   //! Pick up the peg for the chosen move
+   bool startMove()
+   {
+      // A player with no moves passes
+      if(!think_found) return true;
+
+      best_peg_to_move = &peg_list[findPeg(think_move.getStart())];
+
+      best_peg_to_move->setBestMove(think_move);
+
+      return best_peg_to_move->doBestMove(true);
+   }
+
+   bool chooseMove(const BoardState<N>& position, Move<N>& move)
+   {
+      if(random_moves != 0)
+      {
+         random_moves--;
+         return findRandomMove(position, move);
+      }
+      else if(mcts != nullptr)
+      {
+         unsigned soft_ms = 0;
+         unsigned hard_ms = 0;
+
+         if(time_manager != nullptr) time_manager->plan(id, soft_ms, hard_ms);
+
+         return mcts->run(position, playouts, move, hard_ms);
+      }
+      else if(search != nullptr)
+      {
+         typename Search<N>::Limits move_limits = limits;
+
+         if(time_manager != nullptr) time_manager->plan(id, move_limits.soft_ms, move_limits.hard_ms);
+
+         return search->run(position, move_limits, move);
+      }
+
+      return findGreedyMove(position, move);
+   }
+
+   //! Ask a move being chosen on the thinker to finish early
+   void stopChoosing()
+   {
+      stopping.store(true, std::memory_order_relaxed);
+
+      if(search != nullptr) search->stop();
+      if(mcts != nullptr) mcts->stop();
+   }
+
+   //! Choose the reply to each of the likely moves of the player to move
+   //  in ponder_state, until stopped
+   void ponderMoves()
+   {
+      Trace::Span span("Player::ponder");
+
+      Move<N>  likely[PONDER_MOVES];
+      unsigned num_likely = 0;
+      unsigned score;
+
+      move_gen->start(ponder_state, ponder_state.getSideToMove(), hop_mode);
+
+      while((num_likely < PONDER_MOVES) && move_gen->next(likely[num_likely], score))
+      {
+         num_likely++;
+      }
+
+      for(unsigned i = 0; i < num_likely; i++)
+      {
+         BoardState<N> position = ponder_state;
+
+         position.makeMove(likely[i].getStart(), likely[i].getEnd(), id);
 
-         unsigned best_move_score = 0;
+         Pondered& reply = pondered[num_pondered];
 
-         for(auto& peg : peg_list)
+         reply.key   = position.getKey();
+         reply.found = chooseMove(position, reply.move);
+
+         // A reply cut short is not kept
+         if(stopping.load(std::memory_order_relaxed)) return;
+
+         num_pondered++;
+      }
+   }
+
+   //! Use a reply found while pondering if this position was foreseen
+   bool findPondered()
+   {
+      unsigned num = num_pondered;
+
+      num_pondered = 0;
+
+      for(unsigned i = 0; i < num; i++)
+      {
+         if(pondered[i].key == state->getKey())
          {
-            unsigned score = peg.findMoves(/* keep_all_moves */ false);
+            think_move  = pondered[i].move;
+            think_found = pondered[i].found;
 
-            if(score > best_move_score)
-            {
-               best_move_score  = score;
-               best_peg_to_move = &peg;
-            }
+            Stats::count(STAT_TURNS);
+            return true;
          }
       }
 
-      assert(best_peg_to_move != nullptr);
+      return false;
+   }
+
+   //! Pick any move
+   bool findRandomMove(const BoardState<N>& position, Move<N>& move)
+   {
+      // All stages in the order they are generated, which is repeatable
+      move_gen->start(position, id, hop_mode);
+      move_gen->generateOrdered();
+
+      if(move_gen->size() == 0) return false;
+
+      move = (*move_gen)[random.next() % move_gen->size()];
+      return true;
+   }
+
+   //! Find the move with the best score
+   bool findGreedyMove(const BoardState<N>& position, Move<N>& best_move)
+   {
+      Trace::Span span("Player::findGreedyMove");
+
+      TransTable::Entry entry;
+
+      trans_table->newSearch();
+
+      // A position seen before only needs the moves of one peg to
+      // recover the full path of the best move
+      if(trans_table->probe(position.getKey(), entry) &&
+         (entry.bound == BOUND_EXACT) &&
+         MoveGen<N>::findMove(position, id, hop_mode, entry.move, best_move))
+      {
+         return true;
+      }
+
+      // The greedy choice needs every move, so generate all the stages
+      move_gen->start(position, id, hop_mode);
+      move_gen->generateAll();
+
+      if(move_gen->size() == 0) return false;
+
+      unsigned best = 0;
+
+      for(unsigned i = 1; i < move_gen->size(); i++)
+      {
+         if(isBetter(i, best)) best = i;
+      }
+
+      best_move = (*move_gen)[best];
+
+      trans_table->store(position.getKey(), 1, BOUND_EXACT, move_gen->getScore(best), best_move.pack());
+      return true;
+   }
+
+   //! Compare two generated moves, equal scores are resolved in favour
+   //  of the earlier peg and then the earlier move for that peg
+   bool isBetter(unsigned a, unsigned b) const
+   {
+      if(move_gen->getScore(a) != move_gen->getScore(b))
+      {
+         return move_gen->getScore(a) > move_gen->getScore(b);
+      }
+
+      const Move<N>& move_a = (*move_gen)[a];
+      const Move<N>& move_b = (*move_gen)[b];
+
+      if(move_a.getStart() != move_b.getStart())
+      {
+         return findPeg(move_a.getStart()) < findPeg(move_b.getStart());
+      }
+
+      // Moves for a peg are found in order of their directions
+      unsigned length = std::min(std::min(move_a.getLength(), move_b.getLength()),
+                                 unsigned(Move<N>::MAX_PATH));
+
+      for(unsigned i = 0; i < length; i++)
+      {
+         unsigned dir_a = move_a.getDirection(i).getIndex();
+         unsigned dir_b = move_b.getDirection(i).getIndex();
+
+         if(dir_a != dir_b) return dir_a < dir_b;
+      }
+
+      return move_a.getLength() < move_b.getLength();
+   }
 
-      return best_peg_to_move->doBestMove(start_turn);
+   //! Index of the peg in a hole
+   unsigned findPeg(Hole hole) const
+   {
+      for(unsigned i = 0; i < peg_list.size(); i++)
+      {
+         if(peg_list[i].getHole() == hole) return i;
+      }
+
+      assert(!"no peg in hole");
+      return 0;
    }
 
    static constexpr unsigned triangularNumber(unsigned n)
@@ -217,8 +526,39 @@ private:
 
    static const unsigned COUNTERS = triangularNumber(N);
 
-   Board<N>*                    board{nullptr};
+   //! Likely moves of another player that a reply is found for when pondering
+   static const unsigned PONDER_MOVES = 4;
+
+   //! Reply found while pondering
+   struct Pondered
+   {
+      uint64_t key;   //!< Position after the likely move
+      Move<N>  move;
+      bool     found;
+   };
+
+   BoardState<N>*               state{nullptr};
+   MoveGen<N>*                  move_gen{nullptr};
+   TransTable*                  trans_table{nullptr};
+   Search<N>*                   search{nullptr};
+   typename Search<N>::Limits   limits;
+   Mcts<N>*                     mcts{nullptr};
+   unsigned                     playouts{0};
+   unsigned                     random_moves{0};
+   Random                       random;
+   Thinker*                     thinker{nullptr};
+   TimeManager*                 time_manager{nullptr};
+   bool                         thinking{false};
+   std::atomic<bool>            stopping{false};
+   BoardState<N>                think_state;
+   Move<N>                      think_move;
+   bool                         think_found{false};
+   BoardState<N>                ponder_state;
+   Pondered                     pondered[PONDER_MOVES];
+   unsigned                     num_pondered{0};
+   unsigned                     id{0};
    bool                         human{false};
+   HopMode                      hop_mode{HOP_PATHS};
    Dir60                        across;
    std::array<Peg<N>,COUNTERS>  peg_list;
    Peg<N>*                      best_peg_to_move{nullptr};
@@ -34,6 +34,9 @@ public:
    //! Returns the direction as an angle (degrees)
    operator unsigned() const { return (STEP / 2) + value * STEP; }
 
+   //! Returns the direction as an index 0..5 (30 degrees is 0)
+   unsigned getIndex() const { return value; }
+
    //! Rotate the direction 'n' increments of 60 degrees to the right (clockwise)
    Dir60 rotRight(signed n = 1)
    {
@@ -69,6 +72,11 @@ class Pos60
 public:
    Pos60() = default;
 
+   Pos60(signed x_, signed y_)
+      : x(x_)
+      , y(y_)
+   {}
+
    Pos60(Dir60 dir60, signed n)
       : Pos60()
    {
@@ -0,0 +1,56 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+//! Small, fast xorshift64* pseudo random number generator
+//
+//  The same seed always gives the same sequence, so anything that uses it
+//  can be repeated exactly.
+class Random
+{
+public:
+   Random(uint64_t seed_ = 0) { seed(seed_); }
+
+   void seed(uint64_t seed_)
+   {
+      // Zero is the one state that xorshift never leaves
+      state = seed_ == 0 ? 0x9E3779B97F4A7C15ull : seed_;
+   }
+
+   uint32_t next()
+   {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+
+      return uint32_t((state * 0x2545F4914F6CDD1Dull) >> 32);
+   }
+
+private:
+   uint64_t state;
+};
+
+#endif
@@ -0,0 +1,766 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BoardState.h"
+#include "Evaluate.h"
+#include "Move.h"
+#include "MoveGen.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "TransTable.h"
+#include "Zobrist.h"
+
+//! How a game with more than two players is searched
+enum SearchMode : uint8_t
+{
+   SEARCH_PARANOID,   //!< Every other player works against the player searched for
+   SEARCH_BEST_REPLY, //!< Only the strongest reply by any one other player is searched
+   SEARCH_MAXN        //!< Every player makes the move that is best for themselves
+};
+
+
+//! Iterative deepening search for the player to move
+//
+//  Two player games are searched with alpha-beta. Games with more players
+//  are searched with one of the SearchModes. Paranoid and best-reply search
+//  reduce the game to two sides so alpha-beta still applies, max^n works on
+//  a vector of scores, one for each player. The search makes and takes back
+//  moves on its own copy of the board so the board passed in never changes.
+//
+//  Moves are tried hash move first, then the killer moves that last caused
+//  a cut-off at the same ply, then by a history of cut-offs for each
+//  player's move from one hole to another, and then by progress home.
+template <unsigned N>
+class Search
+{
+public:
+   static const unsigned MAX_PLY = 16;
+
+   static const signed WIN      = 1000000;
+   static const signed INFINITE = WIN + 1;
+
+   //! Limits on how far to search, zero for no limit
+   //  Times are from the start of run(), no new iteration is started after
+   //  soft_ms and the search is stopped at hard_ms
+   struct Limits
+   {
+      unsigned depth{0};
+      uint64_t nodes{0};
+      unsigned soft_ms{0};
+      unsigned hard_ms{0};
+   };
+
+   //! Nodes searched between looks at the clock
+   static const unsigned TIME_CHECK_NODES = 64;
+
+   Search(TransTable& trans_table_)
+      : trans_table(trans_table_)
+   {}
+
+   //! Set the players in the order they take turns
+   void setPlayers(const unsigned* player, unsigned num_players_)
+   {
+      num_players = num_players_;
+
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         order[i] = player[i];
+      }
+
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         next_player[order[i]] = order[(i + 1) % num_players];
+      }
+   }
+
+   void setHopMode(HopMode hop_mode_) { hop_mode = hop_mode_; }
+
+   //! Use the hash move, killers and history to order moves, without them
+   //  moves are only ordered by progress home
+   void setOrdering(bool ordering_) { ordering = ordering_; }
+
+   //! Select how games with more than two players are searched
+   void setMode(SearchMode mode_) { mode = mode_; }
+
+   //! Search with more than one thread
+   //  Helper threads run the same iterative deepening on the same position
+   //  and share what they find through the transposition table (Lazy SMP)
+   void setThreads(unsigned num_threads)
+   {
+      helpers.clear();
+
+      for(unsigned i = 1; i < num_threads; i++)
+      {
+         helpers.emplace_back(new Search(trans_table));
+      }
+   }
+
+   unsigned getThreads() const { return 1 + helpers.size(); }
+
+   //! Find the best move for the player to move
+   //  Returns false if there are no moves. When the search is stopped or a
+   //  limit is reached the best move from the deepest completed iteration
+   //  is returned, or before any has completed the best ordered move
+   bool run(const BoardState<N>& state, const Limits& limits_, Move<N>& best_move)
+   {
+      Trace::Span span("Search::run");
+
+      trans_table.newSearch();
+
+      stopping.store(false, std::memory_order_relaxed);
+
+      // Helpers only stop when this thread has finished. Every other helper
+      // starts one ply deeper so that the threads spread over more depths
+      Limits helper_limits;
+      helper_limits.depth = limits_.depth;
+
+      std::vector<std::thread> threads;
+
+      for(unsigned i = 0; i < helpers.size(); i++)
+      {
+         Search& helper = *helpers[i];
+
+         helper.copySettings(*this);
+         helper.stopping.store(false, std::memory_order_relaxed);
+
+         threads.emplace_back([&helper, &state, &helper_limits, i]()
+                              {
+                                 Trace::Span span("Search::helper");
+
+                                 Move<N> move;
+                                 helper.iterate(state, helper_limits, (i % 2) == 0 ? 2 : 1, move);
+                              });
+      }
+
+      bool found = iterate(state, limits_, 1, best_move);
+
+      for(auto& helper : helpers)
+      {
+         helper->stop();
+      }
+
+      for(auto& thread : threads)
+      {
+         thread.join();
+      }
+
+      return found;
+   }
+
+   //! Stop a search in progress, safe to call from another thread
+   void stop() { stopping.store(true, std::memory_order_relaxed); }
+
+   //! Deepest completed iteration of the last search
+   unsigned getDepth() const { return depth; }
+
+   //! Score of the deepest completed iteration, for the player searched for
+   signed getScore() const { return score; }
+
+   //! Nodes searched by the main thread
+   uint64_t getNodes() const { return nodes; }
+
+   //! Nodes searched by all the threads
+   uint64_t getTotalNodes() const
+   {
+      uint64_t total = nodes;
+
+      for(const auto& helper : helpers)
+      {
+         total += helper->nodes;
+      }
+
+      return total;
+   }
+
+   //! Principal variation of the deepest completed iteration as packed moves
+   unsigned getPVLength() const { return best_pv_length; }
+
+   uint32_t getPV(unsigned i) const { return best_pv[i]; }
+
+private:
+   using Clock = std::chrono::steady_clock;
+
+   //! Iterative deepening from first_depth
+   bool iterate(const BoardState<N>& state, const Limits& limits_, unsigned first_depth,
+                Move<N>& best_move)
+   {
+      if(!gen) gen.reset(new MoveGen<N>[MAX_PLY]);
+      if(!history) history.reset(new History);
+
+      memset(killer, 0, sizeof(killer));
+      memset(history.get(), 0, sizeof(History));
+
+      // The search makes and takes back moves on its own copy of the board
+      board    = state;
+      limits   = limits_;
+      start    = Clock::now();
+      root     = state.getSideToMove();
+      root_key = Zobrist<N>::root(root);
+      nodes    = 0;
+      depth    = 0;
+      score    = 0;
+      aborted  = false;
+
+      best_pv_length = 0;
+
+      unsigned max_depth = (limits.depth == 0) || (limits.depth >= MAX_PLY) ? MAX_PLY - 1
+                                                                            : limits.depth;
+      // Until an iteration completes the best ordered move is kept, so that
+      // a search stopped straight away still has a move to make
+      bool found = false;
+      {
+         unsigned move_score;
+
+         gen[0].start(board, root, hop_mode);
+         gen[0].generateOrdered();
+         found = gen[0].next(best_move, move_score);
+      }
+
+      // Two players is a two sided game whatever the mode
+      SearchMode how = num_players > 2 ? mode : SEARCH_PARANOID;
+
+      for(unsigned d = first_depth; d <= max_depth; d++)
+      {
+         root_found = false;
+
+         signed value;
+
+         if(how == SEARCH_MAXN)
+         {
+            Scores scores;
+            maxn(board, 0, d, 0, scores);
+            value = scores.value[root];
+         }
+         else
+         {
+            value = alphaBeta(board, 0, d, -INFINITE, INFINITE);
+         }
+
+         if(aborted)
+         {
+            // Use the best move of a partial first iteration if that's all there is
+            if((depth == 0) && root_found)
+            {
+               best_move = root_move;
+               found     = true;
+            }
+            break;
+         }
+
+         if(!root_found) break;
+
+         best_move = root_move;
+         score     = value;
+         depth     = d;
+         found     = true;
+
+         best_pv_length = pv_length[0];
+
+         for(unsigned i = 0; i < best_pv_length; i++)
+         {
+            best_pv[i] = pv[0][i];
+         }
+
+         // No point searching deeper once the result is known
+         if(how == SEARCH_MAXN)
+         {
+            if(value >= maxSum() - signed(MAX_PLY)) break;
+         }
+         else if((value >= WIN - signed(MAX_PLY)) || (value <= -WIN + signed(MAX_PLY)))
+         {
+            break;
+         }
+
+         // The next iteration would not finish in time
+         if((limits.soft_ms != 0) && (elapsedMs() >= limits.soft_ms)) break;
+      }
+
+      return found;
+   }
+
+   void copySettings(const Search& from)
+   {
+      hop_mode    = from.hop_mode;
+      mode        = from.mode;
+      ordering    = from.ordering;
+      num_players = from.num_players;
+
+      for(unsigned i = 0; i < 6; i++)
+      {
+         order[i] = from.order[i];
+      }
+
+      for(unsigned i = 0; i < 7; i++)
+      {
+         next_player[i] = from.next_player[i];
+      }
+   }
+
+   //! Move scores from Evaluate::move() are within PROGRESS_OFFSET of 1000000
+   static const unsigned PROGRESS_BITS   = 17;
+   static const unsigned PROGRESS_MASK   = (1 << PROGRESS_BITS) - 1;
+   static const unsigned PROGRESS_OFFSET = (1 << (PROGRESS_BITS - 1)) - 1000000;
+   static const unsigned HISTORY_MAX     = (1 << (30 - PROGRESS_BITS)) - 1;
+   static const unsigned KILLER_FIRST    = 3u << 30;
+   static const unsigned KILLER_SECOND   = 2u << 30;
+   static const unsigned HISTORY_SIZE    = HoleTable<N>::NUM_HOLES * HoleTable<N>::NUM_HOLES;
+
+   //! Cut-off history for each player's moves from one hole to another
+   struct History
+   {
+      uint16_t value[7][HISTORY_SIZE];
+   };
+
+   //! A score for each player, indexed by player id
+   struct Scores
+   {
+      signed value[7];
+   };
+
+   //! Win scores count plies from the root, in the table they count plies
+   //  from the position so that they can be used again at another ply
+   static signed scoreToTable(signed score, unsigned ply)
+   {
+      if(score >= WIN - signed(MAX_PLY))  return score + signed(ply);
+      if(score <= -WIN + signed(MAX_PLY)) return score - signed(ply);
+      return score;
+   }
+
+   static signed scoreFromTable(signed score, unsigned ply)
+   {
+      if(score >= WIN - signed(MAX_PLY))  return score - signed(ply);
+      if(score <= -WIN + signed(MAX_PLY)) return score + signed(ply);
+      return score;
+   }
+
+   //! Upper limit on Evaluate::distance() used to turn distances into scores
+   static const signed MAX_DIST = (N * (N + 1) / 2) * 8 * N;
+
+   //! Upper limit on the sum of the scores of all the players
+   signed maxSum() const { return MAX_DIST * signed(num_players); }
+
+   //! Score for a position for the player the search is for
+   signed evaluate(const BoardState<N>& state) const
+   {
+      signed value = 0;
+
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         unsigned player = order[i];
+         signed   dist   = Evaluate<N>::distance(state, player);
+
+         if(player == root)
+         {
+            value -= dist * signed(num_players - 1);
+         }
+         else
+         {
+            value += dist;
+         }
+      }
+
+      return value;
+   }
+
+   //! Score for a position for each player, larger for a player closer to home
+   void evaluate(const BoardState<N>& state, Scores& scores) const
+   {
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         unsigned player = order[i];
+         signed   dist   = Evaluate<N>::distance(state, player);
+
+         scores.value[player] = dist < MAX_DIST ? MAX_DIST - dist : 0;
+      }
+   }
+
+   bool checkLimits()
+   {
+      if(((limits.nodes != 0) && (nodes >= limits.nodes)) ||
+         stopping.load(std::memory_order_relaxed) ||
+         ((limits.hard_ms != 0) && ((nodes % TIME_CHECK_NODES) == 0) && (elapsedMs() >= limits.hard_ms)))
+      {
+         aborted = true;
+      }
+
+      return aborted;
+   }
+
+   //! Time since the search started (ms)
+   unsigned elapsedMs() const
+   {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+   }
+
+   signed alphaBeta(BoardState<N>& state, unsigned ply, unsigned depth_left,
+                    signed alpha, signed beta)
+   {
+      nodes++;
+      Stats::count(STAT_NODES);
+
+      pv_length[ply] = ply;
+
+      if(checkLimits()) return 0;
+
+      if(depth_left == 0) return evaluate(state);
+
+      unsigned player    = state.getSideToMove();
+      bool     maximise  = player == root;
+      uint64_t key       = state.getKey() ^ root_key;
+      uint32_t hash_move = 0;
+
+      TransTable::Entry entry;
+
+      if(trans_table.probe(key, entry))
+      {
+         hash_move = entry.move;
+
+         if((ply != 0) && (entry.depth >= depth_left))
+         {
+            signed score = scoreFromTable(entry.score, ply);
+
+            if((entry.bound == BOUND_EXACT) ||
+               ((entry.bound == BOUND_LOWER) && (score >= beta)) ||
+               ((entry.bound == BOUND_UPPER) && (score <= alpha)))
+            {
+               return score;
+            }
+         }
+      }
+
+      // With best reply search all the other players move in one layer
+      bool     all_others = !maximise && (mode == SEARCH_BEST_REPLY) && (num_players > 2);
+      unsigned mover[6];
+      unsigned num_movers = 0;
+
+      if(all_others)
+      {
+         // The player with the hash move goes first
+         unsigned hash_player = hash_move == 0 ? 0 : state.getPeg(Move<N>::unpackStart(hash_move));
+
+         if((hash_player != 0) && (hash_player != root))
+         {
+            mover[num_movers++] = hash_player;
+         }
+
+         for(unsigned i = 0; i < num_players; i++)
+         {
+            if((order[i] != root) && ((num_movers == 0) || (order[i] != mover[0])))
+            {
+               mover[num_movers++] = order[i];
+            }
+         }
+      }
+      else
+      {
+         mover[num_movers++] = player;
+      }
+
+      signed   alpha_in   = alpha;
+      signed   beta_in    = beta;
+      signed   best_value = maximise ? -INFINITE : INFINITE;
+      uint32_t best       = 0;
+
+      for(unsigned m = 0; (m < num_movers) && (alpha < beta); m++)
+      {
+         MoveGen<N>& moves = gen[ply];
+
+         moves.start(state, mover[m], hop_mode);
+         moves.generateOrdered();
+
+         if(ordering) orderMoves(moves, ply, mover[m], hash_move);
+
+         Move<N>  move;
+         unsigned move_score;
+
+         while(moves.next(move, move_score))
+         {
+            pv_length[ply + 1] = ply + 1;
+
+            typename BoardState<N>::Undo undo =
+               state.makeMove(move.getStart(), move.getEnd(), all_others ? root : next_player[mover[m]]);
+
+            signed value;
+
+            if(state.arePegsHome(mover[m]))
+            {
+               value = maximise ? WIN - signed(ply) : -WIN + signed(ply);
+            }
+            else
+            {
+               value = alphaBeta(state, ply + 1, depth_left - 1, alpha, beta);
+            }
+
+            state.unmakeMove(undo);
+
+            if(aborted) return 0;
+
+            if(maximise ? (value > best_value) : (value < best_value))
+            {
+               best_value = value;
+               best       = move.pack();
+
+               updatePV(ply, best);
+
+               if(ply == 0)
+               {
+                  root_move  = move;
+                  root_found = true;
+               }
+
+               if(maximise)
+               {
+                  if(value > alpha) alpha = value;
+               }
+               else
+               {
+                  if(value < beta) beta = value;
+               }
+
+               if(alpha >= beta)
+               {
+                  if(ordering) addCutoff(ply, mover[m], move, depth_left);
+                  break;
+               }
+            }
+         }
+      }
+
+      if(best == 0)
+      {
+         // No moves
+         return evaluate(state);
+      }
+
+      Bound bound = best_value <= alpha_in ? BOUND_UPPER
+                  : best_value >= beta_in  ? BOUND_LOWER
+                                           : BOUND_EXACT;
+
+      trans_table.store(key, depth_left, bound, scoreToTable(best_value, ply), best);
+
+      return best_value;
+   }
+
+   //! Max^n search, each player picks the move with the best score for themselves
+   //  bound is the best score found so far by the player before. Scores are
+   //  never negative and add up to no more than maxSum(), so once a move
+   //  scores maxSum() - bound or more for this player, the player before
+   //  cannot do better through this position and the rest of the moves are
+   //  skipped (shallow pruning)
+   void maxn(BoardState<N>& state, unsigned ply, unsigned depth_left,
+             signed bound, Scores& result)
+   {
+      nodes++;
+      Stats::count(STAT_NODES);
+
+      pv_length[ply] = ply;
+
+      if(checkLimits()) return;
+
+      if(depth_left == 0)
+      {
+         evaluate(state, result);
+         return;
+      }
+
+      unsigned player    = state.getSideToMove();
+      uint64_t key       = state.getKey() ^ root_key;
+      uint32_t hash_move = 0;
+
+      // Vectors of scores don't fit in the table, so it only orders moves
+      TransTable::Entry entry;
+
+      if(trans_table.probe(key, entry))
+      {
+         hash_move = entry.move;
+      }
+
+      MoveGen<N>& moves = gen[ply];
+
+      moves.start(state, player, hop_mode);
+      moves.generateOrdered();
+
+      if(ordering) orderMoves(moves, ply, player, hash_move);
+
+      uint32_t best = 0;
+      Scores   child_scores;
+      Move<N>  move;
+      unsigned move_score;
+
+      while(moves.next(move, move_score))
+      {
+         pv_length[ply + 1] = ply + 1;
+
+         typename BoardState<N>::Undo undo =
+            state.makeMove(move.getStart(), move.getEnd(), next_player[player]);
+
+         if(state.arePegsHome(player))
+         {
+            for(auto& value : child_scores.value) value = 0;
+
+            child_scores.value[player] = maxSum() - signed(ply);
+         }
+         else
+         {
+            maxn(state, ply + 1, depth_left - 1, best == 0 ? 0 : result.value[player], child_scores);
+         }
+
+         state.unmakeMove(undo);
+
+         if(aborted) return;
+
+         if((best == 0) || (child_scores.value[player] > result.value[player]))
+         {
+            result = child_scores;
+            best   = move.pack();
+
+            updatePV(ply, best);
+
+            if(ply == 0)
+            {
+               root_move  = move;
+               root_found = true;
+            }
+
+            if(result.value[player] >= maxSum() - bound)
+            {
+               if(ordering) addCutoff(ply, player, move, depth_left);
+               break;
+            }
+         }
+      }
+
+      if(best == 0)
+      {
+         // No moves
+         evaluate(state, result);
+         return;
+      }
+
+      trans_table.store(key, depth_left, BOUND_EXACT, result.value[player], best);
+   }
+
+   //! Order the moves for a player at a ply, the hash move first
+   void orderMoves(MoveGen<N>& moves, unsigned ply, unsigned player, uint32_t hash_move)
+   {
+      const uint16_t* from_to = history->value[player];
+
+      // Killers above any history, history above any progress
+      moves.rescore([&](const Move<N>& move, unsigned score) -> unsigned
+                    {
+                       uint32_t packed   = move.pack();
+                       unsigned progress = (score + PROGRESS_OFFSET) & PROGRESS_MASK;
+
+                       if(packed == killer[ply][0]) return KILLER_FIRST;
+                       if(packed == killer[ply][1]) return KILLER_SECOND;
+
+                       unsigned index = move.getStart() * HoleTable<N>::NUM_HOLES + move.getEnd();
+
+                       return (unsigned(from_to[index]) << PROGRESS_BITS) | progress;
+                    });
+
+      if(hash_move != 0) moves.promote(hash_move);
+   }
+
+   //! Remember a move that caused a cut-off
+   void addCutoff(unsigned ply, unsigned player, const Move<N>& move, unsigned depth_left)
+   {
+      uint32_t packed = move.pack();
+
+      if(packed != killer[ply][0])
+      {
+         killer[ply][1] = killer[ply][0];
+         killer[ply][0] = packed;
+      }
+
+      uint16_t* from_to = history->value[player];
+      unsigned  index   = move.getStart() * HoleTable<N>::NUM_HOLES + move.getEnd();
+      unsigned  value   = from_to[index] + depth_left * depth_left;
+
+      // Age the whole history for the player rather than let it saturate
+      if(value > HISTORY_MAX)
+      {
+         for(unsigned i = 0; i < HISTORY_SIZE; i++)
+         {
+            from_to[i] /= 2;
+         }
+
+         value = from_to[index] + depth_left * depth_left;
+      }
+
+      from_to[index] = value;
+   }
+
+   //! Make a move the first of the principal variation from a ply
+   void updatePV(unsigned ply, uint32_t move)
+   {
+      pv[ply][ply] = move;
+
+      for(unsigned i = ply + 1; i < pv_length[ply + 1]; i++)
+      {
+         pv[ply][i] = pv[ply + 1][i];
+      }
+
+      pv_length[ply] = pv_length[ply + 1];
+   }
+
+   TransTable&                          trans_table;
+   std::vector<std::unique_ptr<Search>> helpers;
+   std::unique_ptr<MoveGen<N>[]>        gen;
+   std::unique_ptr<History>             history;
+   uint32_t                             killer[MAX_PLY][2]{};
+   bool                                 ordering{true};
+   HopMode                              hop_mode{HOP_PATHS};
+   SearchMode                           mode{SEARCH_PARANOID};
+   unsigned                             num_players{0};
+   unsigned                             order[6]{};
+   unsigned                             next_player[7]{};
+   Limits                               limits;
+   Clock::time_point                    start;
+   BoardState<N>                        board;
+   unsigned                             root{0};
+   uint64_t                             root_key{0};
+   uint64_t                             nodes{0};
+   unsigned                             depth{0};
+   signed                               score{0};
+   bool                                 aborted{false};
+   std::atomic<bool>                    stopping{false};
+   Move<N>                              root_move;
+   bool                                 root_found{false};
+   uint32_t                             pv[MAX_PLY + 1][MAX_PLY + 1]{};
+   unsigned                             pv_length[MAX_PLY + 1]{};
+   uint32_t                             best_pv[MAX_PLY]{};
+   unsigned                             best_pv_length{0};
+};
+
+#endif
@@ -0,0 +1,192 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+//! Counting is compiled in unless built with STERNH_STATS=0
+#ifndef STERNH_STATS
+#define STERNH_STATS 1
+#endif
+
+enum Stat : uint8_t
+{
+   STAT_NODES,       //!< Positions visited by a search
+   STAT_STEPS,       //!< Single steps generated
+   STAT_HOPS,        //!< First hops generated
+   STAT_EXTENSIONS,  //!< Hops that extend a chain of hops
+   STAT_REJECTS,     //!< Hops not tried because they land back on the chain
+   STAT_MOVE_SCORES, //!< Moves scored to order them
+   STAT_EVALUATIONS, //!< Positions scored for a player
+   STAT_PROBES,      //!< Transposition table look ups
+   STAT_HITS,        //!< Transposition table look ups that found the position
+   STAT_TURNS,       //!< Computer turns
+   STAT_THINK_NS,    //!< Time spent choosing computer moves (ns)
+   NUM_STATS
+};
+
+
+//! A value for each counter
+struct StatCounts
+{
+   uint64_t value[NUM_STATS]{};
+
+   uint64_t operator[](Stat stat) const { return value[stat]; }
+
+   StatCounts operator-(const StatCounts& that) const
+   {
+      StatCounts result;
+
+      for(unsigned i = 0; i < NUM_STATS; i++)
+      {
+         result.value[i] = value[i] - that.value[i];
+      }
+
+      return result;
+   }
+
+   //! Print as a JSON object on one line, head is a list of fields to go first
+   void printJson(const char* head) const
+   {
+      static const char* name[NUM_STATS] =
+      {
+         "nodes", "steps", "hops", "extensions", "rejects", "move_scores",
+         "evaluations", "probes", "hits", "turns", "think_ns"
+      };
+
+      char line[512];
+
+      // snprintf() returns the length it would have written, so a line too
+      // long for the buffer is cut short rather than overrun, leaving room
+      // to close it
+      const unsigned MAX_N = sizeof(line) - 3;
+
+      unsigned n = std::min(unsigned(snprintf(line, sizeof(line), "{%s", head)), MAX_N);
+
+      for(unsigned i = 0; i < NUM_STATS; i++)
+      {
+         n += snprintf(line + n, sizeof(line) - n, ", \"%s\": %llu", name[i], (unsigned long long)value[i]);
+         n  = std::min(n, MAX_N);
+      }
+
+      snprintf(line + n, sizeof(line) - n, "}\n");
+
+      // One write per line so lines from different threads don't mix
+      fputs(line, stdout);
+   }
+
+   //! One line summary for the terminal
+   void format(const char* label, char* text, size_t size) const
+   {
+      snprintf(text, size, "%s %.1f ms, %llu nodes, %llu steps, %llu hops, %llu chain, "
+                           "%llu rejects, %llu scored, %llu evals, %llu/%llu hash",
+               label,
+               value[STAT_THINK_NS] / 1e6,
+               (unsigned long long)value[STAT_NODES],
+               (unsigned long long)value[STAT_STEPS],
+               (unsigned long long)value[STAT_HOPS],
+               (unsigned long long)value[STAT_EXTENSIONS],
+               (unsigned long long)value[STAT_REJECTS],
+               (unsigned long long)value[STAT_MOVE_SCORES],
+               (unsigned long long)value[STAT_EVALUATIONS],
+               (unsigned long long)value[STAT_HITS],
+               (unsigned long long)value[STAT_PROBES]);
+   }
+};
+
+
+//! Counters for the work done by the search and move generation
+//
+//  Each thread counts into its own set of counters without any sharing,
+//  and adds them into a shared total when it finishes or when it asks for
+//  the total. Built with STERNH_STATS=0, count() is empty and every
+//  counter compiles to nothing.
+class Stats
+{
+public:
+   static constexpr bool ENABLED = STERNH_STATS != 0;
+
+   static void count(Stat stat, uint64_t n = 1)
+   {
+      if(ENABLED) local().counts.value[stat] += n;
+   }
+
+   //! Everything counted by this thread
+   static StatCounts thread() { return local().counts; }
+
+   //! Add what this thread has counted to the total now, for a thread that
+   //  lives on between pieces of work
+   static void flush() { local().flush(); }
+
+   //! Everything counted by finished threads and this thread
+   static StatCounts total()
+   {
+      local().flush();
+
+      StatCounts result;
+
+      for(unsigned i = 0; i < NUM_STATS; i++)
+      {
+         result.value[i] = shared()[i].load(std::memory_order_relaxed);
+      }
+
+      return result;
+   }
+
+private:
+   struct Local
+   {
+      StatCounts counts;
+      StatCounts flushed; //!< Part of counts already in the shared total
+
+      ~Local() { flush(); }
+
+      void flush()
+      {
+         for(unsigned i = 0; i < NUM_STATS; i++)
+         {
+            shared()[i].fetch_add(counts.value[i] - flushed.value[i], std::memory_order_relaxed);
+         }
+
+         flushed = counts;
+      }
+   };
+
+   static Local& local()
+   {
+      static thread_local Local counters;
+      return counters;
+   }
+
+   static std::atomic<uint64_t>* shared()
+   {
+      static std::atomic<uint64_t> total[NUM_STATS]{};
+      return total;
+   }
+};
+
+#endif
@@ -0,0 +1,143 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef THINKER_H
+#define THINKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Stats.h"
+
+//! Runs one job at a time on a thread of its own
+//
+//  Used to choose computer moves without holding up the display and the
+//  keyboard. Each job comes with a function that asks it to finish early,
+//  which cancel() keeps calling until the job has finished. Without
+//  threads (Emscripten) a job is run to completion by run().
+class Thinker
+{
+public:
+   using Job = std::function<void()>;
+
+   Thinker() = default;
+
+   ~Thinker()
+   {
+      cancel();
+
+      if(thread.joinable())
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+         }
+
+         wake.notify_all();
+         thread.join();
+      }
+   }
+
+   //! Start a job, after cancelling any job still running
+   //  stop may be called from another thread while the job runs
+   void run(Job job_, Job stop_)
+   {
+      cancel();
+
+#ifdef __EMSCRIPTEN__
+      job_();
+#else
+      if(!thread.joinable()) thread = std::thread([this]() { loop(); });
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+
+         job  = job_;
+         stop = stop_;
+         busy = true;
+      }
+
+      wake.notify_all();
+#endif
+   }
+
+   //! Check if a job is still running
+   bool isBusy()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return busy;
+   }
+
+   //! Ask the job to finish early and wait until it has
+   void cancel()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      while(busy)
+      {
+         // The job may not have reached the part that looks for a stop yet
+         if(stop) stop();
+
+         done.wait_for(lock, std::chrono::milliseconds(1));
+      }
+   }
+
+private:
+   void loop()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      while(true)
+      {
+         wake.wait(lock, [this]() { return quit || busy; });
+
+         if(quit) return;
+
+         Job next = job;
+
+         lock.unlock();
+         next();
+         Stats::flush();
+         lock.lock();
+
+         job  = nullptr;
+         stop = nullptr;
+         busy = false;
+
+         done.notify_all();
+      }
+   }
+
+   std::thread             thread;
+   std::mutex              mutex;
+   std::condition_variable wake;
+   std::condition_variable done;
+   Job                     job;
+   Job                     stop;
+   bool                    busy{false};
+   bool                    quit{false};
+};
+
+#endif
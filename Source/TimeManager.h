@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef TIME_MANAGER_H
+#define TIME_MANAGER_H
+
+#include <algorithm>
+
+//! Share out thinking time for computer moves
+//
+//  Either every move has the same time, or each player has a clock for the
+//  whole game and a move is given a part of what is left. A move is planned
+//  with a soft deadline, after which no new search iteration is started, and
+//  a hard deadline at which the search is stopped.
+class TimeManager
+{
+public:
+   //! Give every move the same time (ms), zero for no limit
+   void setMoveTime(unsigned ms) { move_ms = ms; }
+
+   //! Give each player this much time for a game (ms), zero for no clock
+   //  A clock takes priority over a move time
+   void setClock(unsigned ms) { clock_ms = ms; }
+
+   //! Start a new game with full clocks
+   void reset()
+   {
+      for(unsigned player = 0; player <= 6; player++)
+      {
+         remaining[player] = clock_ms;
+      }
+   }
+
+   bool isLimited() const { return (clock_ms != 0) || (move_ms != 0); }
+
+   //! Deadlines (ms) for the next move of a player
+   void plan(unsigned player, unsigned& soft_ms, unsigned& hard_ms) const
+   {
+      if(clock_ms != 0)
+      {
+         unsigned left   = remaining[player];
+         unsigned budget = std::max(left / MOVES_TO_GO, 1u);
+
+         soft_ms = budget;
+         hard_ms = std::max(std::min(budget * 4, left / 2), budget);
+      }
+      else
+      {
+         soft_ms = move_ms / 2;
+         hard_ms = move_ms;
+      }
+   }
+
+   //! Take the time a move took (ms) off a player's clock
+   void charge(unsigned player, unsigned ms)
+   {
+      remaining[player] -= std::min(ms, remaining[player]);
+   }
+
+private:
+   //! Moves still to come that what is left on a clock is shared between
+   static const unsigned MOVES_TO_GO = 30;
+
+   unsigned move_ms{0};
+   unsigned clock_ms{0};
+   unsigned remaining[7]{};
+};
+
+#endif
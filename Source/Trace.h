@@ -0,0 +1,234 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//! Tracing is compiled in unless built with STERNH_TRACE=0
+#ifndef STERNH_TRACE
+#define STERNH_TRACE 1
+#endif
+
+//! Timeline of where the time goes, written as a Chrome trace
+//
+//  Nothing is recorded until start() is given a file name. After that each
+//  Span records the time from its construction to its destruction into a
+//  ring buffer for the thread, which keeps the most recent spans without
+//  any locking. The buffers are written to the file at exit, in the trace
+//  event JSON format that Perfetto (ui.perfetto.dev) and chrome://tracing
+//  read.
+//
+//  Threads that finish hand their buffer on to the next thread to start,
+//  so the short lived search threads of each turn share a few timelines
+//  instead of having one each.
+class Trace
+{
+public:
+   static constexpr bool COMPILED = STERNH_TRACE != 0;
+
+   //! Spans kept for each thread
+   static const unsigned RING_SIZE = 1 << 16;
+
+   //! Start recording, the trace is written to filename at exit
+   static void start(const char* filename)
+   {
+      Registry& reg = registry();
+
+      if(!COMPILED || (reg.filename != nullptr)) return;
+
+      reg.filename = filename;
+      reg.origin   = std::chrono::steady_clock::now();
+
+      atexit(write);
+
+      enabled().store(true, std::memory_order_relaxed);
+   }
+
+   static bool isEnabled()
+   {
+      return COMPILED && enabled().load(std::memory_order_relaxed);
+   }
+
+   //! Records the time from construction to destruction, name must be a
+   //  string that lasts until the trace is written
+   class Span
+   {
+   public:
+      Span(const char* name_)
+         : name(isEnabled() ? name_ : nullptr)
+      {
+         if(name != nullptr) begin = std::chrono::steady_clock::now();
+      }
+
+      ~Span()
+      {
+         if(name != nullptr) record(name, begin, std::chrono::steady_clock::now());
+      }
+
+   private:
+      const char*                           name;
+      std::chrono::steady_clock::time_point begin;
+   };
+
+private:
+   struct Event
+   {
+      const char*                           name;
+      std::chrono::steady_clock::time_point begin;
+      std::chrono::steady_clock::time_point end;
+   };
+
+   struct Ring
+   {
+      unsigned tid;
+      uint64_t count{0};
+      Event    event[RING_SIZE];
+   };
+
+   struct Registry
+   {
+      std::mutex                         mutex;
+      std::vector<std::unique_ptr<Ring>> rings;
+      std::vector<Ring*>                 free;
+      const char*                        filename{nullptr};
+      std::chrono::steady_clock::time_point origin;
+   };
+
+   //! The ring buffer used by a thread, handed back when the thread finishes
+   struct Holder
+   {
+      Ring* ring{nullptr};
+
+      ~Holder()
+      {
+         if(ring != nullptr)
+         {
+            Registry&                   reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+
+            reg.free.push_back(ring);
+         }
+      }
+   };
+
+   static std::atomic<bool>& enabled()
+   {
+      static std::atomic<bool> flag{false};
+      return flag;
+   }
+
+   static Registry& registry()
+   {
+      static Registry reg;
+      return reg;
+   }
+
+   static Ring& threadRing()
+   {
+      static thread_local Holder holder;
+
+      if(holder.ring == nullptr)
+      {
+         Registry&                   reg = registry();
+         std::lock_guard<std::mutex> lock(reg.mutex);
+
+         if(!reg.free.empty())
+         {
+            holder.ring = reg.free.back();
+            reg.free.pop_back();
+         }
+         else
+         {
+            reg.rings.emplace_back(new Ring);
+            holder.ring      = reg.rings.back().get();
+            holder.ring->tid = reg.rings.size();
+         }
+      }
+
+      return *holder.ring;
+   }
+
+   static void record(const char*                           name,
+                      std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end)
+   {
+      Ring& ring = threadRing();
+
+      ring.event[ring.count++ % RING_SIZE] = Event{name, begin, end};
+   }
+
+   //! Write every ring buffer to the file, oldest span first
+   static void write()
+   {
+      enabled().store(false, std::memory_order_relaxed);
+
+      Registry&                   reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+
+      FILE* fp = fopen(reg.filename, "w");
+      if(fp == nullptr)
+      {
+         fprintf(stderr, "ERROR: failed to write trace \"%s\"\n", reg.filename);
+         return;
+      }
+
+      fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+      const char* sep = "";
+
+      for(const auto& ring : reg.rings)
+      {
+         fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                     "\"args\": {\"name\": \"thread %u\"}}",
+                 sep, ring->tid, ring->tid);
+         sep = ",\n";
+
+         uint64_t first = ring->count > RING_SIZE ? ring->count - RING_SIZE : 0;
+
+         for(uint64_t i = first; i < ring->count; i++)
+         {
+            const Event& event = ring->event[i % RING_SIZE];
+
+            double ts  = std::chrono::duration<double, std::micro>(event.begin - reg.origin).count();
+            double dur = std::chrono::duration<double, std::micro>(event.end - event.begin).count();
+
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                        "\"ts\": %.3f, \"dur\": %.3f}",
+                    event.name, ring->tid, ts, dur);
+         }
+      }
+
+      fprintf(fp, "\n]}\n");
+      fclose(fp);
+   }
+};
+
+#endif
@@ -0,0 +1,243 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef TRANS_TABLE_H
+#define TRANS_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Stats.h"
+
+//! Kind of score stored in the transposition table
+enum Bound : uint8_t
+{
+   BOUND_NONE,
+   BOUND_UPPER, //!< Score is at most the stored score
+   BOUND_LOWER, //!< Score is at least the stored score
+   BOUND_EXACT
+};
+
+
+//! Fixed size transposition table of search results keyed by position hash
+//
+//  The table is a power of two number of buckets, each a cache line of four
+//  entries. The low bits of the key select a bucket. An entry is replaced by
+//  a result for the same position, otherwise the least useful entry of the
+//  bucket is replaced, that is one left from an earlier search or failing
+//  that the shallowest.
+//
+//  The table may be shared by several search threads without any locks.
+//  Each entry is two 64-bit words, the data and the key XORed with the
+//  data. A reader that sees the words of two different writes gets a key
+//  that doesn't match and so treats the entry as a miss.
+class TransTable
+{
+public:
+   struct Entry
+   {
+      uint32_t move{0};     //!< Packed best move, zero for none
+      int32_t  score{0};
+      uint8_t  depth{0};
+      Bound    bound{BOUND_NONE};
+      uint8_t  age{0};
+   };
+
+   TransTable() = default;
+
+   //! Set the size of the table in Mbytes, rounded down to a power of two
+   //  A size of zero disables the table
+   void resize(unsigned mbytes)
+   {
+      if(mbytes == 0)
+      {
+         bucket.reset();
+         num_buckets = 0;
+         return;
+      }
+
+      size_t bytes = size_t(mbytes) << 20;
+
+      num_buckets = 1;
+
+      while((num_buckets * 2 * sizeof(Bucket)) <= bytes)
+      {
+         num_buckets *= 2;
+      }
+
+      bucket.reset(new Bucket[num_buckets]);
+
+      clear();
+   }
+
+   //! Forget every entry, must not be called during a search
+   void clear()
+   {
+      for(size_t i = 0; i < num_buckets; i++)
+      {
+         for(auto& slot : bucket[i].slot)
+         {
+            slot.key_xor_data.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+         }
+      }
+
+      age = 0;
+   }
+
+   //! Start a new search, entries from earlier searches are replaced first
+   //  Must not be called during a search
+   void newSearch() { age++; }
+
+   //! Look up a position, returns true if found
+   bool probe(uint64_t key, Entry& entry) const
+   {
+      if(!bucket) return false;
+
+      Stats::count(STAT_PROBES);
+
+      const Bucket& b = bucket[key & (num_buckets - 1)];
+
+      for(const auto& slot : b.slot)
+      {
+         uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+         if(((slot.key_xor_data.load(std::memory_order_relaxed) ^ data) == key) && (data != 0))
+         {
+            entry = unpack(data);
+
+            if(entry.bound == BOUND_NONE) return false;
+
+            Stats::count(STAT_HITS);
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   //! Record the result of searching a position
+   void store(uint64_t key, unsigned depth, Bound bound, signed score, uint32_t move)
+   {
+      if(!bucket) return;
+
+      Bucket& b      = bucket[key & (num_buckets - 1)];
+      Slot*   victim = &b.slot[0];
+      Entry   old;
+
+      for(auto& slot : b.slot)
+      {
+         uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+         if((data == 0) || ((slot.key_xor_data.load(std::memory_order_relaxed) ^ data) == key))
+         {
+            victim = &slot;
+            old    = unpack(data);
+            break;
+         }
+
+         if(worth(unpack(data)) < worth(unpack(victim->data.load(std::memory_order_relaxed))))
+         {
+            victim = &slot;
+         }
+      }
+
+      Entry entry;
+
+      // Keep the move of a position when the new result doesn't have one
+      entry.move  = move != 0 ? move : old.move;
+      entry.score = score;
+      entry.depth = uint8_t(depth);
+      entry.bound = bound;
+      entry.age   = age;
+
+      uint64_t data = pack(entry);
+
+      victim->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+      victim->data.store(data, std::memory_order_relaxed);
+   }
+
+   size_t getEntries() const { return num_buckets * BUCKET_SIZE; }
+
+private:
+   static const unsigned BUCKET_SIZE = 4;
+
+   struct Slot
+   {
+      std::atomic<uint64_t> key_xor_data{0};
+      std::atomic<uint64_t> data{0};
+   };
+
+   struct alignas(64) Bucket
+   {
+      Slot slot[BUCKET_SIZE];
+   };
+
+   //  Data bits   0..9   move start hole + 1 (zero for no move)
+   //             10..19  move end hole
+   //             20..43  score (signed)
+   //             44..51  depth
+   //             52..53  bound
+   //             54..61  age
+   static uint64_t pack(const Entry& entry)
+   {
+      uint64_t start = entry.move == 0 ? 0 : (entry.move & 0xFFFF) + 1;
+      uint64_t end   = entry.move >> 16;
+
+      uint64_t score = uint32_t(entry.score) & 0xFFFFFF;
+
+      return start                         |
+             (end                   << 10) |
+             (score                 << 20) |
+             (uint64_t(entry.depth) << 44) |
+             (uint64_t(entry.bound) << 52) |
+             (uint64_t(entry.age)   << 54);
+   }
+
+   static Entry unpack(uint64_t data)
+   {
+      Entry    entry;
+      uint32_t start = data & 0x3FF;
+      uint32_t end   = (data >> 10) & 0x3FF;
+
+      entry.move  = start == 0 ? 0 : (start - 1) | (end << 16);
+      entry.score = int32_t(uint32_t(data >> 20) << 8) >> 8;
+      entry.depth = uint8_t(data >> 44);
+      entry.bound = Bound((data >> 52) & 0x3);
+      entry.age   = uint8_t(data >> 54);
+
+      return entry;
+   }
+
+   //! Value of keeping an entry, older searches count against it
+   signed worth(const Entry& e) const
+   {
+      return signed(e.depth) - 8 * signed(uint8_t(age - e.age));
+   }
+
+   std::unique_ptr<Bucket[]> bucket;
+   size_t                    num_buckets{0};
+   uint8_t                   age{0};
+};
+
+#endif
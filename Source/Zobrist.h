@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+#include "Hole.h"
+
+//! Compile time random keys used to hash the positions on a size N board
+//
+//  The key for a position is the XOR of the key for each peg in its hole
+//  and the key for the player whose turn it is. Player zero (no peg, or
+//  no player to move) has a zero key so it can be used without checking.
+template <unsigned N>
+class Zobrist
+{
+public:
+   //! Key for a player's peg in a hole
+   static uint64_t peg(Hole hole, unsigned player) { return table.peg[hole][player]; }
+
+   //! Key for the player whose turn it is
+   static uint64_t side(unsigned player) { return table.side[player]; }
+
+   //! Key for the player a search is being made for, so that results that
+   //  depend on that player are kept apart
+   static uint64_t root(unsigned player) { return table.root[player]; }
+
+private:
+   struct Table
+   {
+      uint64_t peg[HoleTable<N>::NUM_HOLES + 1][7]{};
+      uint64_t side[7]{};
+      uint64_t root[7]{};
+   };
+
+   //! SplitMix64 pseudo random sequence
+   static constexpr uint64_t next(uint64_t& seed)
+   {
+      uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+   }
+
+   static constexpr Table build()
+   {
+      Table    t{};
+      uint64_t seed = N;
+
+      for(unsigned player = 1; player <= 6; player++)
+      {
+         for(unsigned hole = 0; hole < HoleTable<N>::NUM_HOLES; hole++)
+         {
+            t.peg[hole][player] = next(seed);
+         }
+
+         t.side[player] = next(seed);
+      }
+
+      for(unsigned player = 1; player <= 6; player++)
+      {
+         t.root[player] = next(seed);
+      }
+
+      return t;
+   }
+
+   static const Table table;
+};
+
+template <unsigned N>
+constexpr typename Zobrist<N>::Table Zobrist<N>::table = Zobrist<N>::build();
+
+#endif
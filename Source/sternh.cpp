@@ -20,7 +20,12 @@
 // SOFTWARE.
 //------------------------------------------------------------------------------
 
+#include <chrono>
+#include <cstdio>
+
+#include "Batch.h"
 #include "Game.h"
+#include "Perft.h"
 
 #include "TRM/App.h"
 
@@ -45,6 +50,123 @@ private:
       PLT::Event::mainLoop(Game<SIZE>::doIterate, &game);
    }
 
+   template <unsigned SIZE>
+   bool batch()
+   {
+      return Batch<SIZE>(options).run(options.batch, options.threads);
+   }
+
+   template <unsigned SIZE>
+   void perft()
+   {
+      unsigned order[6];
+
+      for(unsigned i = 0; i < options.num_players; i++)
+      {
+         order[i] = 1 + i * (6.0 / options.num_players);
+      }
+
+      BoardState<SIZE> state;
+      Perft<SIZE>      counter;
+
+      Perft<SIZE>::setup(state, order, options.num_players);
+
+      counter.setPlayers(order, options.num_players);
+      counter.setHopMode(options.hop_closure ? HOP_CLOSURE : HOP_PATHS);
+      counter.setDedup(!options.all_paths);
+      counter.setThreads(options.threads);
+      counter.setHashSize(options.hash);
+
+      auto     start = std::chrono::steady_clock::now();
+      uint64_t total = counter.run(state, options.perft);
+      auto     end   = std::chrono::steady_clock::now();
+      double   secs  = std::chrono::duration<double>(end - start).count();
+
+      if(options.divide)
+      {
+         for(unsigned i = 0; i < counter.getRootMoves(); i++)
+         {
+            uint32_t move = counter.getRootMove(i);
+
+            printf("%3u-%-3u %llu\n", Move<SIZE>::unpackStart(move), Move<SIZE>::unpackEnd(move),
+                   (unsigned long long)counter.getRootCount(i));
+         }
+
+         printf("\n");
+      }
+
+      printf("perft %u, size %u, %u players: %llu positions in %.3f s, %.0f positions/s\n",
+             unsigned(options.perft), SIZE, unsigned(options.num_players),
+             (unsigned long long)total, secs, total / secs);
+
+      if(counter.getDropped() != 0)
+      {
+         printf("WARNING: moves were dropped %llu times, the count is too low\n",
+                (unsigned long long)counter.getDropped());
+      }
+
+      if(options.stats) Stats::total().printJson("\"type\": \"perft\"");
+   }
+
+   //! Batch games and perft don't need a terminal
+   //  A trace covers all three and is written at exit
+   virtual int startConsoleApp() override
+   {
+      if(options.trace[0] != '\0') Trace::start(options.trace);
+
+      if(options.batch != 0)
+      {
+         bool ok = true;
+
+         switch(options.size)
+         {
+         case 3: ok = batch<3>(); break;
+         case 4: ok = batch<4>(); break;
+         case 5: ok = batch<5>(); break;
+         case 6: ok = batch<6>(); break;
+         case 7: ok = batch<7>(); break;
+         case 8: ok = batch<8>(); break;
+         case 9: ok = batch<9>(); break;
+         }
+
+         return ok ? 0 : 1;
+      }
+
+      if(options.perft != 0)
+      {
+         switch(options.size)
+         {
+         case 3: perft<3>(); break;
+         case 4: perft<4>(); break;
+         case 5: perft<5>(); break;
+         case 6: perft<6>(); break;
+         case 7: perft<7>(); break;
+         case 8: perft<8>(); break;
+         case 9: perft<9>(); break;
+         }
+
+         return 0;
+      }
+
+      // Report a bad weights file before the terminal takes over
+      bool weights_ok = true;
+
+      switch(options.size)
+      {
+      case 3: weights_ok = loadWeights<3>(options); break;
+      case 4: weights_ok = loadWeights<4>(options); break;
+      case 5: weights_ok = loadWeights<5>(options); break;
+      case 6: weights_ok = loadWeights<6>(options); break;
+      case 7: weights_ok = loadWeights<7>(options); break;
+      case 8: weights_ok = loadWeights<8>(options); break;
+      case 9: weights_ok = loadWeights<9>(options); break;
+      }
+
+      if(!weights_ok) return 1;
+
+      return TRM::App::startConsoleApp();
+   }
+
    virtual int startTerminalApp(TRM::Device& term) override
    {
       TRM::Curses win(&term);
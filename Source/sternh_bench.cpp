@@ -0,0 +1,569 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2017 John D. Haughton
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//------------------------------------------------------------------------------
+
+// Benchmarks for move generation, evaluation, drawing, search and
+// self-play, without any terminal
+//
+// usage: sternh_bench [--json] [--time ms] [max_threads [depth]]
+//
+// Each result is one CSV row (or JSON object) with the columns
+//
+//    bench,size,players,threads,fixture,count,value,unit
+//
+// where count is what was worked on (moves, players, pegs, characters drawn,
+// games, nodes or playouts) and fixture is the hash key of the position
+// measured. Positions are reached from the start by moves picked with a
+// fixed seed from the moves sorted by start and end hole, so they only
+// change if the rules do.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Board.h"
+#include "Mcts.h"
+#include "Perft.h"
+#include "Player.h"
+#include "Random.h"
+#include "Search.h"
+
+
+//! Writes benchmark results as CSV or JSON
+class Report
+{
+public:
+   void setJson(bool json_) { json = json_; }
+
+   void start()
+   {
+      if(json)
+         printf("[\n");
+      else
+         printf("bench,size,players,threads,fixture,count,value,unit\n");
+   }
+
+   void row(const char* bench, unsigned size, unsigned players, unsigned threads,
+            uint64_t fixture, uint64_t count, double value, const char* unit)
+   {
+      if(json)
+      {
+         printf("%s  {\"bench\": \"%s\", \"size\": %u, \"players\": %u, \"threads\": %u, "
+                "\"fixture\": \"%016llx\", \"count\": %llu, \"value\": %.3f, \"unit\": \"%s\"}",
+                rows == 0 ? "" : ",\n", bench, size, players, threads,
+                (unsigned long long)fixture, (unsigned long long)count, value, unit);
+      }
+      else
+      {
+         printf("%s,%u,%u,%u,%016llx,%llu,%.3f,%s\n",
+                bench, size, players, threads,
+                (unsigned long long)fixture, (unsigned long long)count, value, unit);
+      }
+
+      rows++;
+      fflush(stdout);
+   }
+
+   void finish()
+   {
+      if(json) printf("\n]\n");
+   }
+
+private:
+   bool     json{false};
+   unsigned rows{0};
+};
+
+static Report report;
+
+//! Minimum time spent on each measurement
+static double min_ns = 20e6;
+
+//! Results that are otherwise unused, so they are not optimised away
+static volatile unsigned sink;
+
+
+//! Time repeated calls of fn, returns the nanoseconds per call
+template <typename FN>
+double timePerCall(FN fn, uint64_t& calls)
+{
+   using Clock = std::chrono::steady_clock;
+
+   calls = 0;
+
+   auto   start = Clock::now();
+   double ns    = 0.0;
+
+   for(uint64_t batch = 1; ns < min_ns; batch *= 2)
+   {
+      for(uint64_t i = 0; i < batch; i++) fn();
+
+      calls += batch;
+      ns     = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+   }
+
+   return ns / calls;
+}
+
+
+//! Nothing is drawn, but Board still does all of its work
+struct NullWindow
+{
+   unsigned cols{80};
+   unsigned lines{40};
+   unsigned chars{0};
+
+   void fgcolour(unsigned) {}
+   void mvaddch(unsigned, unsigned, char) { chars++; }
+};
+
+
+//! A position reached by a fixed sequence of moves from the start
+template <unsigned N>
+class Position
+{
+public:
+   //! Each player makes moves_each moves, picked with a fixed seed
+   Position(unsigned num_players_, unsigned moves_each)
+      : num_players(num_players_)
+   {
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         order[i] = 1 + i * (6.0 / num_players);
+      }
+
+      Perft<N>::setup(state, order, num_players);
+
+      Random     random(N * 100 + num_players);
+      MoveGen<N> move_gen;
+
+      for(unsigned turn = 0; turn < moves_each * num_players; turn++)
+      {
+         unsigned player = order[turn % num_players];
+
+         move_gen.start(state, player, HOP_PATHS);
+         move_gen.generateOrdered();
+
+         std::vector<uint32_t> moves;
+
+         for(unsigned i = 0; i < move_gen.size(); i++)
+         {
+            moves.push_back(move_gen[i].pack());
+         }
+
+         std::sort(moves.begin(), moves.end());
+
+         unsigned next = order[(turn + 1) % num_players];
+
+         if(moves.empty())
+         {
+            state.setSideToMove(next);
+            continue;
+         }
+
+         uint32_t move = moves[random.next() % moves.size()];
+
+         state.makeMove(Move<N>::unpackStart(move), Move<N>::unpackEnd(move), next);
+
+         // Keep going from the start if a player finishes
+         if(state.arePegsHome(player)) Perft<N>::setup(state, order, num_players);
+      }
+   }
+
+   const BoardState<N>& getState() const { return state; }
+
+   const unsigned* getOrder() const { return order; }
+
+   unsigned getNumPlayers() const { return num_players; }
+
+   uint64_t getKey() const { return state.getKey(); }
+
+private:
+   BoardState<N> state;
+   unsigned      order[6];
+   unsigned      num_players;
+};
+
+
+//! Moves for each peg of the player to move, as MoveGen::findMoves() finds them,
+//! and with the staged generator
+template <unsigned N>
+void findMoves(const Position<N>& position)
+{
+   const BoardState<N>& state  = position.getState();
+   unsigned             player = state.getSideToMove();
+   unsigned             moves  = 0;
+   uint64_t             calls;
+
+   double ns = timePerCall([&]()
+                           {
+                              moves = 0;
+
+                              state.getPegs(player).forEach([&](unsigned bit)
+                                                            {
+                                                               MoveGen<N>::findMoves(state, HoleTable<N>::getHole(bit), HOP_PATHS,
+                                                                                     [&moves](const Move<N>&) { moves++; });
+                                                            });
+                           },
+                           calls);
+
+   report.row("find_moves", N, position.getNumPlayers(), 1, position.getKey(), moves, ns, "ns");
+
+   MoveGen<N> move_gen;
+
+   ns = timePerCall([&]()
+                    {
+                       move_gen.start(state, player, HOP_PATHS);
+                       move_gen.generateOrdered();
+                    },
+                    calls);
+
+   report.row("move_gen", N, position.getNumPlayers(), 1, position.getKey(), move_gen.size(), ns, "ns");
+}
+
+
+//! Scoring moves and positions
+template <unsigned N>
+void evaluate(const Position<N>& position)
+{
+   const BoardState<N>& state  = position.getState();
+   unsigned             player = state.getSideToMove();
+   uint64_t             calls;
+
+   MoveGen<N> move_gen;
+   move_gen.start(state, player, HOP_PATHS);
+   move_gen.generateOrdered();
+
+   unsigned sum = 0;
+
+   double ns = timePerCall([&]()
+                           {
+                              for(unsigned i = 0; i < move_gen.size(); i++)
+                              {
+                                 sum += Evaluate<N>::move(player, move_gen[i]);
+                              }
+                           },
+                           calls);
+
+   report.row("eval_moves", N, position.getNumPlayers(), 1, position.getKey(), move_gen.size(), ns, "ns");
+
+   ns = timePerCall([&]()
+                    {
+                       for(unsigned i = 0; i < position.getNumPlayers(); i++)
+                       {
+                          sum += Evaluate<N>::distance(state, position.getOrder()[i]);
+                       }
+                    },
+                    calls);
+
+   report.row("eval_position", N, position.getNumPlayers(), 1, position.getKey(), position.getNumPlayers(), ns, "ns");
+   sink = sum;
+}
+
+
+//! Resetting the board and players for a new game, with the board drawn
+template <unsigned N>
+void reset(unsigned num_players)
+{
+   NullWindow                   window;
+   BoardState<N>                state;
+   Board<N, NullWindow>         board(window, state);
+   MoveGen<N>                   move_gen;
+   TransTable                   trans_table;
+   std::unique_ptr<Player<N>[]> players(new Player<N>[6]);
+   uint64_t                     calls;
+
+   double ns = timePerCall([&]()
+                           {
+                              state.clear();
+
+                              for(unsigned i = 0; i < num_players; i++)
+                              {
+                                 players[i].initialise(state, move_gen, trans_table,
+                                                       1 + i * (6.0 / num_players), /* human */ false);
+                              }
+                           },
+                           calls);
+
+   report.row("reset", N, num_players, 1, state.getKey(), state.getOccupied().count(), ns, "ns");
+}
+
+
+//! Drawing the changes between two positions
+template <unsigned N>
+void refresh(const Position<N>& from, const Position<N>& to)
+{
+   NullWindow           window;
+   BoardState<N>        state;
+   Board<N, NullWindow> board(window, state);
+   uint64_t             calls;
+   bool                 flip = false;
+
+   board.refresh();
+
+   window.chars = 0;
+
+   double ns = timePerCall([&]()
+                           {
+                              flip  = !flip;
+                              state = flip ? to.getState() : from.getState();
+
+                              board.boardChanged();
+                              board.refresh();
+                           },
+                           calls);
+
+   report.row("refresh", N, to.getNumPlayers(), 1, to.getKey(), window.chars / calls, ns, "ns");
+}
+
+
+//! Greedy computer games with random opening moves
+//  Every chain of hops is exponential in a crowded middle on the larger
+//  boards, so these games find one chain of hops to each hole
+template <unsigned N>
+void selfPlay(unsigned num_players)
+{
+   // Greedy players can get stuck in a jam, so games are cut short
+   static const unsigned MAX_TURNS = 20 * N;
+
+   BoardState<N>                state;
+   MoveGen<N>                   move_gen;
+   TransTable                   trans_table;
+   std::unique_ptr<Player<N>[]> players(new Player<N>[6]);
+   unsigned                     game = 0;
+
+   trans_table.resize(1);
+
+   auto   start = std::chrono::steady_clock::now();
+   double ns    = 0.0;
+
+   while((ns < min_ns * 10) || (game == 0))
+   {
+      state.clear();
+      trans_table.clear();
+
+      for(unsigned i = 0; i < num_players; i++)
+      {
+         players[i].initialise(state, move_gen, trans_table, 1 + i * (6.0 / num_players), /* human */ false);
+         players[i].setHopMode(HOP_CLOSURE);
+         players[i].setRandomMoves(2, game * 8 + i);
+      }
+
+      for(unsigned turn = 0; turn < MAX_TURNS * num_players; turn++)
+      {
+         Player<N>& player = players[turn % num_players];
+
+         state.setSideToMove(player.getId());
+
+         for(bool start_turn = true; !player.takeATurn(start_turn, 0); start_turn = false);
+
+         if(player.areAllPegsHome()) break;
+      }
+
+      game++;
+
+      ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+   }
+
+   report.row("self_play", N, num_players, 1, 0, game, game * 1e9 / ns, "games/s");
+}
+
+
+//! Micro benchmarks and self-play for one size and number of players
+template <unsigned N>
+void benchSize(unsigned num_players)
+{
+   Position<N> fixture[3] = {Position<N>(num_players, N),
+                             Position<N>(num_players, 2 * N),
+                             Position<N>(num_players, 3 * N)};
+
+   for(const auto& position : fixture)
+   {
+      findMoves(position);
+      evaluate(position);
+   }
+
+   refresh(fixture[0], fixture[2]);
+   reset<N>(num_players);
+   selfPlay<N>(num_players);
+}
+
+
+template <unsigned N>
+void benchSize()
+{
+   for(unsigned num_players : {2, 3, 4, 6})
+   {
+      benchSize<N>(num_players);
+   }
+}
+
+
+//! Time for the main search thread to complete every depth up to a limit,
+//! for 1, 2, 4 ... max_threads threads
+template <unsigned N>
+void timeToDepth(unsigned num_players, unsigned moves_each, unsigned depth, unsigned max_threads)
+{
+   Position<N> position(num_players, moves_each);
+
+   for(unsigned threads = 1; threads <= max_threads; threads *= 2)
+   {
+      TransTable trans_table;
+      trans_table.resize(64);
+
+      Search<N> search(trans_table);
+      search.setPlayers(position.getOrder(), position.getNumPlayers());
+      search.setMode(SEARCH_BEST_REPLY);
+      search.setThreads(threads);
+
+      typename Search<N>::Limits limits;
+      limits.depth = depth;
+
+      Move<N> move;
+
+      auto start = std::chrono::steady_clock::now();
+
+      search.run(position.getState(), limits, move);
+
+      auto   end = std::chrono::steady_clock::now();
+      double ms  = std::chrono::duration<double, std::milli>(end - start).count();
+
+      report.row("search_depth", N, num_players, threads, position.getKey(), search.getTotalNodes(), ms, "ms");
+   }
+}
+
+
+//! Nodes searched to a depth with and without move ordering
+template <unsigned N>
+void orderingGain(unsigned num_players, unsigned moves_each, unsigned depth)
+{
+   Position<N> position(num_players, moves_each);
+
+   for(unsigned ordering = 0; ordering <= 1; ordering++)
+   {
+      TransTable trans_table;
+      trans_table.resize(64);
+
+      Search<N> search(trans_table);
+      search.setPlayers(position.getOrder(), position.getNumPlayers());
+      search.setMode(SEARCH_BEST_REPLY);
+      search.setOrdering(ordering != 0);
+
+      typename Search<N>::Limits limits;
+      limits.depth = depth;
+
+      Move<N> move;
+
+      search.run(position.getState(), limits, move);
+
+      report.row(ordering != 0 ? "search_ordered" : "search_unordered", N, num_players, 1,
+                 position.getKey(), depth, search.getNodes(), "nodes");
+   }
+}
+
+
+//! Monte Carlo playout rate for 1, 2, 4 ... max_threads threads
+template <unsigned N>
+void playoutRate(unsigned num_players, unsigned moves_each, unsigned playouts, unsigned max_threads)
+{
+   Position<N> position(num_players, moves_each);
+
+   for(unsigned threads = 1; threads <= max_threads; threads *= 2)
+   {
+      Mcts<N> mcts;
+      mcts.setPlayers(position.getOrder(), position.getNumPlayers());
+      mcts.setThreads(threads);
+
+      Move<N> move;
+
+      auto start = std::chrono::steady_clock::now();
+
+      mcts.run(position.getState(), playouts, move);
+
+      auto   end = std::chrono::steady_clock::now();
+      double ms  = std::chrono::duration<double, std::milli>(end - start).count();
+
+      report.row("mcts", N, num_players, threads, position.getKey(), mcts.getPlayouts(),
+                 mcts.getPlayouts() * 1000.0 / ms, "playouts/s");
+   }
+}
+
+
+int main(int argc, const char* argv[])
+{
+   unsigned max_threads = std::thread::hardware_concurrency();
+   unsigned depth       = 4;
+   unsigned arg         = 0;
+
+   for(int i = 1; i < argc; i++)
+   {
+      if(strcmp(argv[i], "--json") == 0)
+      {
+         report.setJson(true);
+      }
+      else if((strcmp(argv[i], "--time") == 0) && ((i + 1) < argc))
+      {
+         min_ns = atof(argv[++i]) * 1e6;
+      }
+      else if(arg++ == 0)
+      {
+         max_threads = atoi(argv[i]);
+      }
+      else
+      {
+         depth = atoi(argv[i]);
+      }
+   }
+
+   if(max_threads == 0) max_threads = 1;
+
+   report.start();
+
+   benchSize<3>();
+   benchSize<4>();
+   benchSize<5>();
+   benchSize<6>();
+   benchSize<7>();
+   benchSize<8>();
+   benchSize<9>();
+
+   timeToDepth<5>(2, 10, depth, max_threads);
+   timeToDepth<5>(3, 10, depth, max_threads);
+   timeToDepth<4>(6, 5, depth, max_threads);
+
+   orderingGain<3>(2, 5, depth);
+   orderingGain<4>(2, 8, depth);
+   orderingGain<5>(2, 10, depth);
+   orderingGain<6>(2, 12, depth);
+   orderingGain<5>(3, 10, depth);
+   orderingGain<4>(6, 5, depth);
+
+   playoutRate<5>(2, 10, 2000, max_threads);
+   playoutRate<4>(6, 5, 2000, max_threads);
+
+   report.finish();
+
+   return 0;
+}